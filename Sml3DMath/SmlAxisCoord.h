@@ -9,6 +9,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/epsilon.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "SmlMatVecUtils.h"
 
@@ -214,6 +215,19 @@ public:
         _axis[2] = glm::tvec4<T>{toNormalize ? glm::normalize(zV) : zV, T{0}};
     }
 
+    //blend between two poses, axis is slerped, origin and unit length are lerped
+    //both axis should be unit and orthogonal matrix
+    static AxisCoord Interpolate(const AxisCoord& from, const AxisCoord& to, T ratio)
+    {
+        AxisCoord ac;
+        auto rotFrom = glm::quat_cast(from._axis);
+        auto rotTo = glm::quat_cast(to._axis);
+        ac._axis = glm::mat4_cast(glm::slerp(rotFrom, rotTo, ratio));
+        ac._unitLen = glm::mix(from._unitLen, to._unitLen, ratio);
+        ac._origin = glm::mix(from._origin, to._origin, ratio);
+        return ac;
+    }
+
     void SetIsBaseAxis(bool isBaseAxis)
     {
         _isBaseAxis = isBaseAxis;
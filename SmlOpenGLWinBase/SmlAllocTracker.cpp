@@ -0,0 +1,406 @@
+#include "SmlAllocTracker.h"
+
+#include <QThread>
+#include <QDebug>
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <algorithm>
+
+
+static SmlAllocTracker::ThreadSlot g_allocSlots[SmlAllocTracker::SML_ALLOC_MAX_THREADS];
+static std::atomic<bool> g_allocSlotUsed[SmlAllocTracker::SML_ALLOC_RETIRED_SLOT];
+static std::atomic<int> g_allocSlotCount{ 0 }; //high water mark of the reusable slots
+static std::atomic<bool> g_allocOverflowWarned{ false };
+static std::atomic<const char*> g_allocPhases[SmlAllocTracker::SML_ALLOC_MAX_PHASES];
+
+static SmlAllocAssert SmlInitialAssertMode()
+{
+    const char* mode = std::getenv("SML_ALLOC_ASSERT");
+    if (mode && 0 == strcmp(mode, "fatal"))
+    {
+        return SmlAllocAssert::Fatal;
+    }
+    if (mode && 0 == strcmp(mode, "warn"))
+    {
+        return SmlAllocAssert::Warn;
+    }
+    return SmlAllocAssert::Off;
+}
+
+static std::atomic<SmlAllocAssert> g_allocAssert{ SmlInitialAssertMode() };
+static std::atomic<int> g_allocWarmupFrames{ 120 };
+
+
+static const char* SmlAllocSlotName(const SmlAllocTracker::ThreadSlot* slot)
+{
+    return slot == &g_allocSlots[SmlAllocTracker::SML_ALLOC_RETIRED_SLOT] ? "retired threads" : slot->name;
+}
+
+//gives the slot back when the thread exits
+struct SmlAllocSlotGuard
+{
+    ~SmlAllocSlotGuard() { SmlAllocTracker::ReleaseSlot(); }
+};
+
+void SmlAllocTracker::ClaimSlot()
+{
+    ThreadState& state = State();
+    state.slot = &g_allocSlots[SML_ALLOC_RETIRED_SLOT]; //table full
+    for (int ii = 0; ii < SML_ALLOC_RETIRED_SLOT; ++ii)
+    {
+        bool used = false;
+        if (g_allocSlotUsed[ii].compare_exchange_strong(used, true, std::memory_order_acq_rel))
+        {
+            state.slot = &g_allocSlots[ii];
+            int count = g_allocSlotCount.load(std::memory_order_relaxed);
+            while (count <= ii && !g_allocSlotCount.compare_exchange_weak(count, ii + 1, std::memory_order_relaxed))
+            {
+            }
+            break;
+        }
+    }
+
+    if (&g_allocSlots[SML_ALLOC_RETIRED_SLOT] != state.slot)
+    {
+        //registering the destructor may allocate, state.slot is already set for that
+        static thread_local SmlAllocSlotGuard guard;
+        (void)guard;
+    }
+}
+
+void SmlAllocTracker::ReleaseSlot()
+{
+    ThreadState& state = State();
+    ThreadSlot* slot = state.slot;
+    ThreadSlot& retired = g_allocSlots[SML_ALLOC_RETIRED_SLOT];
+    if (nullptr == slot || &retired == slot)
+    {
+        return;
+    }
+    state.slot = &retired; //what the rest of the thread exit frees
+
+    for (int ii = 0; ii < SML_ALLOC_MAX_PHASES; ++ii)
+    {
+        Counter& counter = slot->phases[ii];
+        retired.phases[ii].allocs.fetch_add(counter.allocs.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.phases[ii].bytes.fetch_add(counter.bytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.phases[ii].frees.fetch_add(counter.frees.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    slot->named.store(false, std::memory_order_relaxed);
+    g_allocSlotUsed[slot - g_allocSlots].store(false, std::memory_order_release);
+}
+
+int SmlAllocTracker::PhaseId(const char* name)
+{
+    for (int ii = 1; ii < SML_ALLOC_MAX_PHASES; ++ii)
+    {
+        const char* phase = g_allocPhases[ii].load(std::memory_order_acquire);
+        if (nullptr == phase)
+        {
+            if (g_allocPhases[ii].compare_exchange_strong(phase, name, std::memory_order_acq_rel))
+            {
+                return ii;
+            }
+            //another thread took the slot, phase holds its name now
+        }
+
+        if (phase == name || 0 == strcmp(phase, name))
+        {
+            return ii;
+        }
+    }
+    return 0;
+}
+
+const char* SmlAllocTracker::PhaseName(int id)
+{
+    const char* name = id > 0 && id < SML_ALLOC_MAX_PHASES ? g_allocPhases[id].load(std::memory_order_acquire) : nullptr;
+    return name ? name : "(no phase)";
+}
+
+void SmlAllocTracker::NameThread()
+{
+    ThreadState& state = State();
+    if (state.slot && state.slot->named.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    bool exempt = state.exempt;
+    state.exempt = true; //the lookup below allocates
+    if (nullptr == state.slot)
+    {
+        ClaimSlot();
+    }
+
+    if (&g_allocSlots[SML_ALLOC_RETIRED_SLOT] == state.slot)
+    {
+        if (!g_allocOverflowWarned.load(std::memory_order_relaxed) && !g_allocOverflowWarned.exchange(true))
+        {
+            qWarning() << "SmlAllocTracker: more than" << SML_ALLOC_RETIRED_SLOT
+                << "threads alive, the later ones are counted together as retired threads";
+        }
+        state.exempt = exempt;
+        return;
+    }
+
+    QThread* thread = QThread::currentThread();
+    QByteArray name = thread ? thread->objectName().toUtf8() : QByteArray{};
+    if (name.isEmpty())
+    {
+        name = "thread " + QByteArray::number(qint64(state.slot - g_allocSlots));
+    }
+    qstrncpy(state.slot->name, name.constData(), sizeof(state.slot->name));
+    state.slot->named.store(true, std::memory_order_release);
+    state.exempt = exempt;
+}
+
+void SmlAllocTracker::SetAssertMode(SmlAllocAssert mode, int warmupFrames)
+{
+    g_allocWarmupFrames.store(std::max(warmupFrames, 0));
+    g_allocAssert.store(mode);
+}
+
+SmlAllocAssert SmlAllocTracker::AssertMode()
+{
+    return g_allocAssert.load(std::memory_order_relaxed);
+}
+
+int SmlAllocTracker::WarmupFrames()
+{
+    return g_allocWarmupFrames.load(std::memory_order_relaxed);
+}
+
+void SmlAllocTracker::ReportFrameAllocs(const char* frameName, quint64 frameIndex, const quint64* phaseAllocsBefore)
+{
+    ThreadState& state = State();
+    bool exempt = state.exempt;
+    state.exempt = true;
+
+    QByteArray phases;
+    for (int ii = 0; ii < SML_ALLOC_MAX_PHASES; ++ii)
+    {
+        quint64 allocs = state.slot->phases[ii].allocs.load(std::memory_order_relaxed) - phaseAllocsBefore[ii];
+        if (allocs)
+        {
+            phases += QByteArray{ " " } + PhaseName(ii) + " " + QByteArray::number(allocs);
+        }
+    }
+
+    QByteArray message = QByteArray{ frameName } + " frame " + QByteArray::number(frameIndex)
+        + " allocated in the steady state on " + SmlAllocSlotName(state.slot) + ":" + phases;
+    if (SmlAllocAssert::Fatal == AssertMode())
+    {
+        qFatal("%s", message.constData());
+    }
+    qWarning("%s", message.constData());
+
+    state.exempt = exempt;
+}
+
+std::vector<SmlAllocThreadStats> SmlAllocTracker::Snapshot()
+{
+    std::vector<SmlAllocThreadStats> threads;
+    int count = g_allocSlotCount.load();
+    for (int tt = 0; tt <= SML_ALLOC_RETIRED_SLOT; ++tt)
+    {
+        if (tt == count)
+        {
+            tt = SML_ALLOC_RETIRED_SLOT; //unused in between
+        }
+
+        const ThreadSlot& slot = g_allocSlots[tt];
+        SmlAllocThreadStats stats;
+        if (SML_ALLOC_RETIRED_SLOT == tt)
+        {
+            stats.thread = SmlAllocSlotName(&slot);
+        }
+        else
+        {
+            stats.thread = slot.named.load(std::memory_order_acquire) ? QByteArray{ slot.name } : "thread " + QByteArray::number(tt);
+        }
+        for (int ii = 0; ii < SML_ALLOC_MAX_PHASES; ++ii)
+        {
+            const Counter& counter = slot.phases[ii];
+            SmlAllocPhaseStats phase;
+            phase.phase = PhaseName(ii);
+            phase.allocs = counter.allocs.load(std::memory_order_relaxed);
+            phase.bytes = counter.bytes.load(std::memory_order_relaxed);
+            phase.frees = counter.frees.load(std::memory_order_relaxed);
+            if (phase.allocs || phase.frees)
+            {
+                stats.phases.push_back(phase);
+            }
+        }
+        threads.push_back(std::move(stats));
+    }
+    return threads;
+}
+
+void SmlAllocTracker::DumpAll()
+{
+    for (const SmlAllocThreadStats& thread : Snapshot())
+    {
+        for (const SmlAllocPhaseStats& phase : thread.phases)
+        {
+            qDebug().nospace() << thread.thread.constData() << " / " << phase.phase
+                << ": allocs " << phase.allocs
+                << " bytes " << phase.bytes
+                << " frees " << phase.frees;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+SmlAllocFrame::SmlAllocFrame(const char* name, quint64 frameIndex) :
+    _name{ name },
+    _frameIndex{ frameIndex }
+{
+    _checked = SmlAllocAssert::Off != SmlAllocTracker::AssertMode() && frameIndex >= quint64(SmlAllocTracker::WarmupFrames());
+    if (!_checked)
+    {
+        return;
+    }
+
+    SmlAllocTracker::NameThread();
+    SmlAllocTracker::ThreadState& state = SmlAllocTracker::State();
+    _strictBefore = state.strictAllocs;
+    for (int ii = 0; ii < SmlAllocTracker::SML_ALLOC_MAX_PHASES; ++ii)
+    {
+        _phaseAllocsBefore[ii] = state.slot->phases[ii].allocs.load(std::memory_order_relaxed);
+    }
+}
+
+SmlAllocFrame::~SmlAllocFrame()
+{
+    if (_checked && SmlAllocTracker::State().strictAllocs != _strictBefore)
+    {
+        SmlAllocTracker::ReportFrameAllocs(_name, _frameIndex, _phaseAllocsBefore);
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////
+//allocation hooks
+#if defined(SML_ENABLE_ALLOC_TRACKER)
+
+#if defined(__GLIBC__)
+//the executable's definitions win over libc's for every library in the process,
+//operator new of libstdc++ ends up here as well
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+    SmlAllocTracker::CountAlloc(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    SmlAllocTracker::CountAlloc(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    SmlAllocTracker::CountAlloc(size); //counted as a new block, the old one is gone either way
+    if (ptr)
+    {
+        SmlAllocTracker::CountFree();
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    SmlAllocTracker::CountAlloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    SmlAllocTracker::CountAlloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    SmlAllocTracker::CountAlloc(size);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+void free(void* ptr)
+{
+    if (ptr)
+    {
+        SmlAllocTracker::CountFree();
+    }
+    __libc_free(ptr);
+}
+}
+
+#else
+//no portable way to interpose malloc, only what goes through the global operator new
+//is seen (not Qt's containers)
+void* operator new(size_t size)
+{
+    SmlAllocTracker::CountAlloc(size);
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    SmlAllocTracker::CountAlloc(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr)
+    {
+        SmlAllocTracker::CountFree();
+    }
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+#endif
+
+#endif
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QByteArray>
+
+#include <atomic>
+#include <vector>
+
+//heap allocation counts and bytes per thread and per phase (named scopes on the stack of
+//a thread, the innermost one gets the allocation); with SML_ENABLE_ALLOC_TRACKER
+//(cmake -DSML_ENABLE_ALLOC_TRACKER=ON) malloc, calloc, realloc and the aligned variants
+//are interposed on glibc, which also catches operator new and Qt's containers, elsewhere
+//only the global operator new / delete are replaced; without it the SML_ALLOC_ macros
+//compile to nothing and every count stays zero
+#if defined(SML_ENABLE_ALLOC_TRACKER)
+#define SML_ALLOC_CONCAT_(a, b) a##b
+#define SML_ALLOC_CONCAT(a, b) SML_ALLOC_CONCAT_(a, b)
+#define SML_ALLOC_PHASE(name) SmlAllocPhase SML_ALLOC_CONCAT(_smlAllocPhase, __LINE__){ name, false }
+#define SML_ALLOC_PHASE_EXEMPT(name) SmlAllocPhase SML_ALLOC_CONCAT(_smlAllocPhase, __LINE__){ name, true }
+#define SML_ALLOC_FRAME(name, frameIndex) SmlAllocFrame SML_ALLOC_CONCAT(_smlAllocFrame, __LINE__){ name, frameIndex }
+#define SML_ALLOC_DUMP() SmlAllocTracker::DumpAll()
+#else
+#define SML_ALLOC_PHASE(name) do {} while (0)
+#define SML_ALLOC_PHASE_EXEMPT(name) do {} while (0)
+#define SML_ALLOC_FRAME(name, frameIndex) do {} while (0)
+#define SML_ALLOC_DUMP() do {} while (0)
+#endif
+
+
+enum class SmlAllocAssert
+{
+    Off,
+    Warn,  //qWarning with the phases that allocated
+    Fatal, //qFatal, for the steady state test runs
+};
+
+struct SmlAllocPhaseStats
+{
+    const char* phase{ nullptr };
+    quint64 allocs{ 0 };
+    quint64 bytes{ 0 };
+    quint64 frees{ 0 };
+};
+
+struct SmlAllocThreadStats
+{
+    QByteArray thread;
+    std::vector<SmlAllocPhaseStats> phases; //only phases that allocated or freed
+};
+
+
+class SmlAllocTracker final
+{
+public:
+    inline static constexpr int SML_ALLOC_MAX_PHASES = 32;  //phase 0 is outside every phase
+    //a slot is given back when its thread exits and its counts move to the last slot,
+    //"retired threads"; threads beyond the table are counted there as well
+    inline static constexpr int SML_ALLOC_MAX_THREADS = 64;
+    inline static constexpr int SML_ALLOC_RETIRED_SLOT = SML_ALLOC_MAX_THREADS - 1;
+
+    struct Counter
+    {
+        std::atomic<quint64> allocs{ 0 };
+        std::atomic<quint64> bytes{ 0 };
+        std::atomic<quint64> frees{ 0 };
+    };
+
+    struct ThreadSlot
+    {
+        std::atomic<bool> named{ false };
+        char name[48]{};
+        Counter phases[SML_ALLOC_MAX_PHASES];
+    };
+
+    //trivially constructed so the allocation hooks can use it before anything else runs
+    struct ThreadState
+    {
+        ThreadSlot* slot;
+        int phase;
+        bool exempt;
+        quint64 strictAllocs; //allocations outside exempt phases
+    };
+
+private:
+    static void ClaimSlot(); //sets State().slot
+
+public:
+    static ThreadState& State()
+    {
+        static thread_local ThreadState state{ nullptr, 0, false, 0 };
+        return state;
+    }
+
+    //allocation hooks, must not allocate
+    static void CountAlloc(size_t bytes)
+    {
+        ThreadState& state = State();
+        if (nullptr == state.slot)
+        {
+            ClaimSlot();
+        }
+        Counter& counter = state.slot->phases[state.phase];
+        counter.allocs.fetch_add(1, std::memory_order_relaxed);
+        counter.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        state.strictAllocs += !state.exempt;
+    }
+
+    static void CountFree()
+    {
+        ThreadState& state = State();
+        if (nullptr == state.slot)
+        {
+            ClaimSlot();
+        }
+        state.slot->phases[state.phase].frees.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static int PhaseId(const char* name); //0 when the phase table is full
+    static const char* PhaseName(int id);
+    static void NameThread(); //QThread::objectName, once per thread
+    static void ReleaseSlot(); //thread exit
+
+    //frames before SmlAllocFrame starts checking, caches and pools fill up in them;
+    //the initial mode comes from SML_ALLOC_ASSERT=warn|fatal
+    static void SetAssertMode(SmlAllocAssert mode, int warmupFrames = 120);
+    static SmlAllocAssert AssertMode();
+    static int WarmupFrames();
+    static void ReportFrameAllocs(const char* frameName, quint64 frameIndex, const quint64* phaseAllocsBefore);
+
+    //any thread
+    static std::vector<SmlAllocThreadStats> Snapshot();
+    static void DumpAll();
+};
+
+
+//the innermost phase of a thread gets its allocations, an exempt phase is counted but
+//does not fail SmlAllocFrame (QPainter, driver calls, logging)
+class SmlAllocPhase final
+{
+private:
+    int _prevPhase{ 0 };
+    bool _prevExempt{ false };
+
+public:
+    SmlAllocPhase(const char* name, bool exempt)
+    {
+        SmlAllocTracker::NameThread();
+
+        SmlAllocTracker::ThreadState& state = SmlAllocTracker::State();
+        _prevPhase = state.phase;
+        _prevExempt = state.exempt;
+        state.phase = SmlAllocTracker::PhaseId(name);
+        state.exempt = exempt || _prevExempt;
+    }
+
+    ~SmlAllocPhase()
+    {
+        SmlAllocTracker::ThreadState& state = SmlAllocTracker::State();
+        state.phase = _prevPhase;
+        state.exempt = _prevExempt;
+    }
+
+    SmlAllocPhase(const SmlAllocPhase&) = delete;
+    SmlAllocPhase& operator=(const SmlAllocPhase&) = delete;
+};
+
+
+//one iteration of a steady state loop: after the warm up frames, an allocation outside
+//exempt phases on this thread is reported according to SmlAllocTracker::AssertMode
+class SmlAllocFrame final
+{
+private:
+    const char* _name{ nullptr };
+    quint64 _frameIndex{ 0 };
+    bool _checked{ false };
+    quint64 _strictBefore{ 0 };
+    quint64 _phaseAllocsBefore[SmlAllocTracker::SML_ALLOC_MAX_PHASES]; //only filled when checked
+
+public:
+    SmlAllocFrame(const char* name, quint64 frameIndex);
+    ~SmlAllocFrame();
+
+    SmlAllocFrame(const SmlAllocFrame&) = delete;
+    SmlAllocFrame& operator=(const SmlAllocFrame&) = delete;
+};
@@ -0,0 +1,126 @@
+#include "SmlFramePacer.h"
+
+#include <chrono>
+#include <algorithm>
+
+
+static qint64 SmlEma(qint64 average, qint64 sample)
+{
+    return 0 == average ? sample : average + (sample - average) / 8;
+}
+
+qint64 SmlFramePacer::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SmlFramePacer::Configure(const SmlFramePacing& pacing, qreal refreshRate)
+{
+    _pacing = pacing;
+    _pacing.targetFps = std::max(_pacing.targetFps, 1);
+    _pacing.swapInterval = std::max(_pacing.swapInterval, 0);
+
+    if (SmlPacingMode::SwapInterval == _pacing.mode)
+    {
+        qreal rate = refreshRate > 0 ? refreshRate : 60.0;
+        _periodNs.store(qint64(1e9 / rate) * std::max(_pacing.swapInterval, 1));
+    }
+    else
+    {
+        _periodNs.store(1000000000ll / _pacing.targetFps);
+    }
+    _mode.store(_pacing.mode);
+
+    _nextStartNs = 0;
+    _deadlineNs.store(0);
+}
+
+void SmlFramePacer::FrameBegin()
+{
+    _frameBeginNs.store(NowNs());
+}
+
+void SmlFramePacer::FrameEnd()
+{
+    qint64 now = NowNs();
+    _costEmaNs.store(SmlEma(_costEmaNs.load(), now - _frameBeginNs.load()));
+
+    qint64 lastPresent = _lastPresentNs.exchange(now);
+    if (lastPresent)
+    {
+        qint64 interval = now - lastPresent;
+        _intervalEmaNs.store(SmlEma(_intervalEmaNs.load(), interval));
+
+        //vsync paced frames have no explicit deadline, a missed vblank shows up as a long interval
+        if (SmlPacingMode::SwapInterval == _mode.load() && interval > _periodNs.load() * 3 / 2)
+        {
+            ++_framesMissed;
+        }
+    }
+
+    qint64 deadline = _deadlineNs.load();
+    if (deadline && now > deadline)
+    {
+        ++_framesMissed;
+    }
+
+    ++_framesPresented;
+}
+
+int SmlFramePacer::ScheduleNext()
+{
+    qint64 now = NowNs();
+    qint64 period = _periodNs.load();
+
+    switch (_pacing.mode)
+    {
+    case SmlPacingMode::TargetFps:
+    case SmlPacingMode::Deadline:
+    {
+        //advance on a fixed grid so the rate does not drift with scheduling jitter
+        if (0 == _nextStartNs || now - _nextStartNs > period)
+        {
+            _nextStartNs = now; //fell behind by more than a frame, restart the grid
+        }
+        else
+        {
+            _nextStartNs += period;
+        }
+
+        qint64 deadline = _nextStartNs + period;
+        qint64 start = _nextStartNs;
+        if (SmlPacingMode::Deadline == _pacing.mode)
+        {
+            //start late enough to sample input as fresh as possible, with a quarter frame margin
+            qint64 cost = _costEmaNs.load();
+            start = std::max(_nextStartNs, deadline - cost - cost / 4 - period / 4);
+        }
+
+        _deadlineNs.store(deadline);
+        return int(std::max<qint64>(start - now, 0) / 1000000);
+    }
+
+    case SmlPacingMode::SwapInterval:
+    case SmlPacingMode::Unpaced:
+    default:
+        _deadlineNs.store(0);
+        return 0;
+    }
+}
+
+void SmlFramePacer::FrameDropped()
+{
+    ++_framesDropped;
+}
+
+SmlFramePacingStats SmlFramePacer::Stats() const
+{
+    SmlFramePacingStats stats;
+    stats.framesPresented = _framesPresented.load();
+    stats.framesMissed = _framesMissed.load();
+    stats.framesDropped = _framesDropped.load();
+    stats.avgFrameIntervalMs = _intervalEmaNs.load() / 1e6;
+    stats.avgFrameCostMs = _costEmaNs.load() / 1e6;
+    return stats;
+}
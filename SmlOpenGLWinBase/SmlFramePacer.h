@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+
+enum class SmlPacingMode
+{
+    Unpaced,        //next frame is requested as soon as the previous one is done
+    TargetFps,      //frame starts on a fixed timestamp grid of 1/targetFps
+    SwapInterval,   //swapBuffers blocks on vsync, next frame is requested right away
+    Deadline,       //frame starts as late as possible to finish before the next grid deadline
+};
+
+struct SmlFramePacing
+{
+    SmlPacingMode mode{ SmlPacingMode::Unpaced };
+    int targetFps{ 60 };
+    int swapInterval{ 1 };
+};
+
+struct SmlFramePacingStats
+{
+    quint64 framesPresented{ 0 };
+    quint64 framesMissed{ 0 };   //finished after their deadline
+    quint64 framesDropped{ 0 };  //never rendered, e.g. the ctx was not handed over in time
+    double avgFrameIntervalMs{ 0 };
+    double avgFrameCostMs{ 0 };
+};
+
+
+//schedules frame starts on the ui thread from timestamps taken on the render thread
+class SmlFramePacer final
+{
+private:
+    SmlFramePacing _pacing;
+
+    //configured on the ui thread, also read by the render thread
+    std::atomic<SmlPacingMode> _mode{ SmlPacingMode::Unpaced };
+    std::atomic<qint64> _periodNs{ 16666666 };
+
+    //ui thread
+    qint64 _nextStartNs{ 0 };
+
+    //written by the render thread, read by the ui thread
+    std::atomic<qint64> _deadlineNs{ 0 };
+    std::atomic<qint64> _frameBeginNs{ 0 };
+    std::atomic<qint64> _lastPresentNs{ 0 };
+    std::atomic<qint64> _costEmaNs{ 0 };
+    std::atomic<qint64> _intervalEmaNs{ 0 };
+
+    std::atomic<quint64> _framesPresented{ 0 };
+    std::atomic<quint64> _framesMissed{ 0 };
+    std::atomic<quint64> _framesDropped{ 0 };
+
+public:
+    static qint64 NowNs();
+
+    void Configure(const SmlFramePacing& pacing, qreal refreshRate);
+    const SmlFramePacing& Pacing() const { return _pacing; }
+
+    //render thread
+    void FrameBegin();
+    void FrameEnd();
+
+    //ui thread, returns the delay in ms until the next frame should start
+    int ScheduleNext();
+    void FrameDropped();
+
+    SmlFramePacingStats Stats() const;
+};
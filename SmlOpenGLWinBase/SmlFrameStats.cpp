@@ -0,0 +1,204 @@
+#include "SmlFrameStats.h"
+#include "SmlFramePacer.h"
+
+#include <QMutexLocker>
+#include <algorithm>
+
+
+/////////////////////////////////////////////////////////////////
+int SmlHdrHistogram::BucketOf(quint64 us)
+{
+    us = std::min<quint64>(us, (2ull << SML_MAX_BITS) - 1);
+    if (us < (2ull << SML_SUB_BITS))
+    {
+        return int(us); //exact below 2^(SML_SUB_BITS + 1)
+    }
+
+    int msb = 63 - __builtin_clzll(us);
+    int shift = msb - SML_SUB_BITS;
+    int sub = int(us >> shift) - (1 << SML_SUB_BITS);
+    return ((shift + 1) << SML_SUB_BITS) + sub;
+}
+
+quint64 SmlHdrHistogram::ValueOf(int bucket)
+{
+    if (bucket < (2 << SML_SUB_BITS))
+    {
+        return quint64(bucket);
+    }
+
+    int shift = (bucket >> SML_SUB_BITS) - 1;
+    quint64 sub = quint64(bucket & ((1 << SML_SUB_BITS) - 1)) + (1ull << SML_SUB_BITS);
+    return (sub << shift) + ((1ull << shift) >> 1);
+}
+
+void SmlHdrHistogram::Record(quint64 us)
+{
+    ++_counts[BucketOf(us)];
+    ++_total;
+    _maxUs = std::max(_maxUs, us);
+}
+
+void SmlHdrHistogram::Add(const SmlHdrHistogram& other)
+{
+    for (int ii = 0; ii < SML_BUCKETS; ++ii)
+    {
+        _counts[ii] += other._counts[ii];
+    }
+    _total += other._total;
+    _maxUs = std::max(_maxUs, other._maxUs);
+}
+
+void SmlHdrHistogram::Reset()
+{
+    std::fill(std::begin(_counts), std::end(_counts), 0u);
+    _total = 0;
+    _maxUs = 0;
+}
+
+quint64 SmlHdrHistogram::PercentileUs(double ratio) const
+{
+    if (0 == _total)
+    {
+        return 0;
+    }
+
+    quint64 rank = std::min<quint64>(quint64(ratio * _total), _total - 1);
+    quint64 seen = 0;
+    for (int ii = 0; ii < SML_BUCKETS; ++ii)
+    {
+        seen += _counts[ii];
+        if (seen > rank)
+        {
+            return std::min(ValueOf(ii), _maxUs);
+        }
+    }
+    return _maxUs;
+}
+
+
+/////////////////////////////////////////////////////////////////
+void SmlFrameStats::Record(SmlFrameMetric metric, qint64 ns)
+{
+    qint64 second = SmlFramePacer::NowNs() / 1000000000ll;
+
+    QMutexLocker<QMutex> locker{ &_mutex };
+    if (_slots.empty())
+    {
+        _slots.resize(SML_WINDOW_SLOTS);
+    }
+
+    Slot& slot = _slots[second % SML_WINDOW_SLOTS];
+    if (slot.second != second)
+    {
+        for (SmlHdrHistogram& histogram : slot.histograms)
+        {
+            histogram.Reset(); //a minute old, recycled
+        }
+        slot.second = second;
+    }
+    slot.histograms[int(metric)].Record(quint64(std::max<qint64>(ns, 0) / 1000));
+}
+
+void SmlFrameStats::ResolveGpu()
+{
+    //oldest first, never waits: a pair that is not available yet is looked at again next frame
+    for (quint64 ii = _frameIndex >= SML_GPU_LATENCY ? _frameIndex - SML_GPU_LATENCY : 0; ii < _frameIndex; ++ii)
+    {
+        int slot = int(ii % SML_GPU_LATENCY);
+        if (!_queryPending[slot])
+        {
+            continue;
+        }
+
+        GLint available = GL_FALSE;
+        _gl->glGetQueryObjectiv(_queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (GL_FALSE == available)
+        {
+            break;
+        }
+
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        _gl->glGetQueryObjectui64v(_queries[slot][0], GL_QUERY_RESULT, &begin);
+        _gl->glGetQueryObjectui64v(_queries[slot][1], GL_QUERY_RESULT, &end);
+        _queryPending[slot] = false;
+
+        Record(SmlFrameMetric::GpuFrame, qint64(end - begin));
+    }
+}
+
+void SmlFrameStats::FrameBegin(QOpenGLFunctions_PROFILE* gl)
+{
+    _cpuBeginNs = SmlFramePacer::NowNs();
+
+    if (nullptr == _gl)
+    {
+        _gl = gl;
+        _gl->glGenQueries(SML_GPU_LATENCY * 2, &_queries[0][0]);
+        std::fill(std::begin(_queryPending), std::end(_queryPending), false);
+    }
+
+    ResolveGpu();
+
+    int slot = int(_frameIndex % SML_GPU_LATENCY);
+    _queryPending[slot] = false; //still not back after SML_GPU_LATENCY frames, dropped
+    _gl->glQueryCounter(_queries[slot][0], GL_TIMESTAMP);
+}
+
+void SmlFrameStats::GpuEnd()
+{
+    int slot = int(_frameIndex % SML_GPU_LATENCY);
+    _gl->glQueryCounter(_queries[slot][1], GL_TIMESTAMP);
+    _queryPending[slot] = true;
+}
+
+void SmlFrameStats::FrameEnd()
+{
+    qint64 now = SmlFramePacer::NowNs();
+    Record(SmlFrameMetric::CpuFrame, now - _cpuBeginNs);
+    if (_lastPresentNs)
+    {
+        Record(SmlFrameMetric::PresentInterval, now - _lastPresentNs);
+    }
+    _lastPresentNs = now;
+
+    ++_frameIndex;
+}
+
+void SmlFrameStats::Destroy()
+{
+    if (_gl)
+    {
+        _gl->glDeleteQueries(SML_GPU_LATENCY * 2, &_queries[0][0]);
+        _gl = nullptr;
+    }
+    _lastPresentNs = 0; //the next ctx starts a new present sequence
+}
+
+SmlFrameTimePercentiles SmlFrameStats::Percentiles(SmlFrameMetric metric, int windowSeconds) const
+{
+    windowSeconds = std::clamp(windowSeconds, 1, SML_WINDOW_SLOTS);
+    qint64 now = SmlFramePacer::NowNs() / 1000000000ll;
+
+    SmlHdrHistogram merged;
+    {
+        QMutexLocker<QMutex> locker{ &_mutex };
+        for (const Slot& slot : _slots)
+        {
+            //the current second counts as one of the window's slots
+            if (slot.second >= 0 && now - slot.second < windowSeconds)
+            {
+                merged.Add(slot.histograms[int(metric)]);
+            }
+        }
+    }
+
+    SmlFrameTimePercentiles percentiles;
+    percentiles.count = merged.Count();
+    percentiles.p50Ms = merged.PercentileUs(0.50) / 1e3;
+    percentiles.p95Ms = merged.PercentileUs(0.95) / 1e3;
+    percentiles.p99Ms = merged.PercentileUs(0.99) / 1e3;
+    percentiles.maxMs = merged.MaxUs() / 1e3;
+    return percentiles;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QMutex>
+
+#include <vector>
+
+#include "SmlGLFunctions.h"
+
+enum class SmlFrameMetric
+{
+    CpuFrame,          //render thread, make current to after swapBuffers
+    GpuFrame,          //gpu time between the timestamps around GLPaint
+    PresentInterval,   //swapBuffers return to the next swapBuffers return
+};
+
+struct SmlFrameTimePercentiles
+{
+    quint64 count{ 0 };
+    double p50Ms{ 0 };
+    double p95Ms{ 0 };
+    double p99Ms{ 0 };
+    double maxMs{ 0 };
+};
+
+
+//log linear histogram of microseconds, every power of two is split into
+//2^SML_SUB_BITS buckets so a percentile is off by at most 1/32 of its value
+class SmlHdrHistogram final
+{
+public:
+    inline static constexpr int SML_SUB_BITS = 5;
+    inline static constexpr int SML_MAX_BITS = 27; //2^27 us is a bit over 2 minutes, larger values are clamped
+    inline static constexpr int SML_BUCKETS = (SML_MAX_BITS - SML_SUB_BITS + 2) << SML_SUB_BITS;
+
+private:
+    quint32 _counts[SML_BUCKETS]{};
+    quint64 _total{ 0 };
+    quint64 _maxUs{ 0 };
+
+private:
+    static int BucketOf(quint64 us);
+    static quint64 ValueOf(int bucket); //middle of the bucket
+
+public:
+    void Record(quint64 us);
+    void Add(const SmlHdrHistogram& other);
+    void Reset();
+
+    quint64 Count() const { return _total; }
+    quint64 MaxUs() const { return _maxUs; }
+    quint64 PercentileUs(double ratio) const;
+};
+
+
+//frame time histograms over a sliding window of one second slots
+//recorded on the render thread, read from any thread
+class SmlFrameStats final
+{
+public:
+    inline static constexpr int SML_WINDOW_SLOTS = 60; //longest window in seconds
+
+private:
+    inline static constexpr int SML_METRICS = 3;
+    inline static constexpr int SML_GPU_LATENCY = 4; //frames before a gpu query pair is read back
+
+    struct Slot
+    {
+        qint64 second{ -1 };
+        SmlHdrHistogram histograms[SML_METRICS];
+    };
+
+    mutable QMutex _mutex;
+    std::vector<Slot> _slots; //allocated by the first record
+
+    //render thread
+    QOpenGLFunctions_PROFILE* _gl{ nullptr };
+    GLuint _queries[SML_GPU_LATENCY][2]{};
+    bool _queryPending[SML_GPU_LATENCY]{};
+    quint64 _frameIndex{ 0 };
+    qint64 _cpuBeginNs{ 0 };
+    qint64 _lastPresentNs{ 0 };
+
+private:
+    void Record(SmlFrameMetric metric, qint64 ns);
+    void ResolveGpu();
+
+public:
+    SmlFrameStats() = default;
+    SmlFrameStats(const SmlFrameStats&) = delete;
+    SmlFrameStats& operator=(const SmlFrameStats&) = delete;
+
+    //render thread, ctx current
+    void FrameBegin(QOpenGLFunctions_PROFILE* gl);
+    void GpuEnd(); //after the frame's draw calls, before swapBuffers
+    void FrameEnd(); //after swapBuffers
+    void Destroy();
+
+    //any thread, windowSeconds in [1, SML_WINDOW_SLOTS]
+    SmlFrameTimePercentiles Percentiles(SmlFrameMetric metric, int windowSeconds) const;
+};
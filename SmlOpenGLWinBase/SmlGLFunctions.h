@@ -0,0 +1,9 @@
+#pragma once
+
+#if defined(_USE_OPENGL_COMPT)
+#include <QOpenGLFunctions_4_5_Compatibility>
+#define QOpenGLFunctions_PROFILE QOpenGLFunctions_4_5_Compatibility
+#else
+#include <QOpenGLFunctions_4_5_Core>
+#define QOpenGLFunctions_PROFILE QOpenGLFunctions_4_5_Core
+#endif
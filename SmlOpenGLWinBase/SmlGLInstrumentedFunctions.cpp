@@ -0,0 +1,219 @@
+#include "SmlGLInstrumentedFunctions.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <iterator>
+
+SmlGLInstrumentedFunctions::SmlGLInstrumentedFunctions()
+{
+    InvalidateGLState();
+    for (int ii = 0; ii < SML_GL_ENTRY_COUNT; ++ii)
+    {
+        _glFrame[ii].name = EntryName(Entry(ii));
+    }
+}
+
+const char* SmlGLInstrumentedFunctions::EntryName(Entry entry)
+{
+    switch (entry)
+    {
+    case UseProgram: return "glUseProgram";
+    case BindVertexArray: return "glBindVertexArray";
+    case BindBuffer: return "glBindBuffer";
+    case BindBufferBase: return "glBindBufferBase";
+    case BindBufferRange: return "glBindBufferRange";
+    case BindFramebuffer: return "glBindFramebuffer";
+    case ActiveTexture: return "glActiveTexture";
+    case BindTexture: return "glBindTexture";
+    case BindTextureUnit: return "glBindTextureUnit";
+    case BindSampler: return "glBindSampler";
+    case Enable: return "glEnable";
+    case Disable: return "glDisable";
+    case Viewport: return "glViewport";
+    case ClearColor: return "glClearColor";
+    case FrontFace: return "glFrontFace";
+    case CullFace: return "glCullFace";
+    case BlendFunc: return "glBlendFunc";
+    case DepthMask: return "glDepthMask";
+    case ProgramUniform1i: return "glProgramUniform1i";
+    case ProgramUniform1f: return "glProgramUniform1f";
+    case ProgramUniform2fv: return "glProgramUniform2fv";
+    case ProgramUniform3fv: return "glProgramUniform3fv";
+    case ProgramUniform4fv: return "glProgramUniform4fv";
+    case ProgramUniformMatrix4fv: return "glProgramUniformMatrix4fv";
+    case Uniform1i: return "glUniform1i";
+    case Uniform1f: return "glUniform1f";
+    case Uniform3fv: return "glUniform3fv";
+    case Uniform4fv: return "glUniform4fv";
+    case UniformMatrix4fv: return "glUniformMatrix4fv";
+    case Clear: return "glClear";
+    case DrawArrays: return "glDrawArrays";
+    case DrawElements: return "glDrawElements";
+    case DrawArraysInstanced: return "glDrawArraysInstanced";
+    case DrawElementsInstanced: return "glDrawElementsInstanced";
+    case LinkProgram: return "glLinkProgram";
+    case DeleteProgram: return "glDeleteProgram";
+    default: return "?";
+    }
+}
+
+GLuint* SmlGLInstrumentedFunctions::BufferSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER: return &_glState.arrayBuffer;
+    case GL_ELEMENT_ARRAY_BUFFER: return &_glState.elementBuffer;
+    case GL_UNIFORM_BUFFER: return &_glState.uniformBuffer;
+    default: return nullptr; //counted, never redundant
+    }
+}
+
+bool SmlGLInstrumentedFunctions::TrackCap(GLenum cap, GLuint on)
+{
+    for (int ii = 0; ii < SML_CAPS; ++ii)
+    {
+        if (_glState.caps[ii] == cap)
+        {
+            return TrackValue(_glState.capsOn[ii], on);
+        }
+    }
+
+    for (int ii = 0; ii < SML_CAPS; ++ii)
+    {
+        if (0 == _glState.caps[ii])
+        {
+            _glState.caps[ii] = cap;
+            _glState.capsOn[ii] = on;
+            return false;
+        }
+    }
+    return false; //table full, counted only
+}
+
+bool SmlGLInstrumentedFunctions::TrackUniform(GLuint program, GLint location, const void* data, size_t bytes)
+{
+    if (location < 0 || nullptr == data)
+    {
+        return false;
+    }
+
+    quint64 key = (quint64(program) << 32) | quint32(location);
+    if (bytes > SML_MAX_UNIFORM_BYTES)
+    {
+        _glUniforms.erase(key);
+        return false;
+    }
+
+    UniformValue& value = _glUniforms[key]; //allocates once per uniform
+    bool same = value.bytes == bytes && 0 == memcmp(value.data, data, bytes);
+    value.bytes = bytes;
+    memcpy(value.data, data, bytes);
+    return same;
+}
+
+void SmlGLInstrumentedFunctions::DropUniforms(GLuint program)
+{
+    for (auto it = _glUniforms.begin(); it != _glUniforms.end();)
+    {
+        it = GLuint(it->first >> 32) == program ? _glUniforms.erase(it) : std::next(it);
+    }
+}
+
+void SmlGLInstrumentedFunctions::InvalidateGLState()
+{
+    _glState.program = SML_UNKNOWN;
+    _glState.vao = SML_UNKNOWN;
+    _glState.arrayBuffer = SML_UNKNOWN;
+    _glState.elementBuffer = SML_UNKNOWN;
+    _glState.uniformBuffer = SML_UNKNOWN;
+    std::fill(std::begin(_glState.uniformBindings), std::end(_glState.uniformBindings), SML_UNKNOWN);
+    std::fill(std::begin(_glState.uniformOffsets), std::end(_glState.uniformOffsets), -1);
+    std::fill(std::begin(_glState.uniformSizes), std::end(_glState.uniformSizes), -1);
+    _glState.drawFramebuffer = SML_UNKNOWN;
+    _glState.readFramebuffer = SML_UNKNOWN;
+    _glState.activeTexture = SML_UNKNOWN;
+    std::fill(std::begin(_glState.texture2D), std::end(_glState.texture2D), SML_UNKNOWN);
+    std::fill(std::begin(_glState.samplers), std::end(_glState.samplers), SML_UNKNOWN);
+    std::fill(std::begin(_glState.caps), std::end(_glState.caps), 0);
+    std::fill(std::begin(_glState.capsOn), std::end(_glState.capsOn), SML_UNKNOWN);
+    _glState.viewportKnown = false;
+    _glState.clearColorKnown = false;
+    _glState.frontFace = SML_UNKNOWN;
+    _glState.cullFace = SML_UNKNOWN;
+    _glState.blendSrc = SML_UNKNOWN;
+    _glState.blendDst = SML_UNKNOWN;
+    _glState.depthMask = SML_UNKNOWN;
+}
+
+void SmlGLInstrumentedFunctions::ResetGLState()
+{
+    InvalidateGLState();
+    _glUniforms.clear();
+}
+
+void SmlGLInstrumentedFunctions::SetGLInstrumented(bool on)
+{
+    if (on == _glInstrumented)
+    {
+        return;
+    }
+
+    //nothing was tracked while off, start over from unknown state and zero counts
+    ResetGLState();
+    _glInstrumented = on;
+    if (on)
+    {
+        QMutexLocker<QMutex> locker{ &_glStatsMutex };
+        _glStats = SmlGLCallStats{};
+        _glStats.total.assign(std::begin(_glFrame), std::end(_glFrame));
+        for (SmlGLCallCount& count : _glStats.total)
+        {
+            count.calls = 0;
+            count.redundant = 0;
+        }
+    }
+}
+
+void SmlGLInstrumentedFunctions::GLFrameBegin()
+{
+    if (!_glInstrumented)
+    {
+        return;
+    }
+
+    //the bindings of the last frame may have been changed by whatever ran in between
+    InvalidateGLState();
+    for (SmlGLCallCount& count : _glFrame)
+    {
+        count.calls = 0;
+        count.redundant = 0;
+    }
+}
+
+void SmlGLInstrumentedFunctions::GLFrameEnd()
+{
+    if (!_glInstrumented)
+    {
+        return;
+    }
+
+    QMutexLocker<QMutex> locker{ &_glStatsMutex };
+    ++_glStats.frames;
+    _glStats.lastFrame.assign(std::begin(_glFrame), std::end(_glFrame));
+    _glStats.lastFrameCalls = 0;
+    _glStats.lastFrameRedundant = 0;
+    for (int ii = 0; ii < SML_GL_ENTRY_COUNT; ++ii)
+    {
+        _glStats.lastFrameCalls += _glFrame[ii].calls;
+        _glStats.lastFrameRedundant += _glFrame[ii].redundant;
+        _glStats.total[ii].calls += _glFrame[ii].calls;
+        _glStats.total[ii].redundant += _glFrame[ii].redundant;
+    }
+}
+
+SmlGLCallStats SmlGLInstrumentedFunctions::GLCallStats() const
+{
+    QMutexLocker<QMutex> locker{ &_glStatsMutex };
+    return _glStats;
+}
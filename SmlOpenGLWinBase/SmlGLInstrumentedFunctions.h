@@ -0,0 +1,560 @@
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+#include "SmlGLFunctions.h"
+
+struct SmlGLCallCount
+{
+    const char* name{ nullptr };
+    quint64 calls{ 0 };
+    quint64 redundant{ 0 }; //set a binding or uniform to the value it already had
+};
+
+struct SmlGLCallStats
+{
+    quint64 frames{ 0 };                  //frames counted since the instrumentation went on
+    std::vector<SmlGLCallCount> lastFrame; //per entry point, latest counted frame
+    std::vector<SmlGLCallCount> total;     //per entry point, summed over all counted frames
+    quint64 lastFrameCalls{ 0 };
+    quint64 lastFrameRedundant{ 0 };
+};
+
+//QOpenGLFunctions_PROFILE with the per frame hot entry points shadowed: binds, state
+//switches, uniform writes and draws are counted and compared against a shadow copy of
+//the state they set, a call that changes nothing is counted as redundant
+//derived classes call glXxx unqualified and get the shadowed version, calls through a
+//QOpenGLFunctions_PROFILE* (loader thread, profiler, QPainter) are not seen; when the
+//instrumentation is off a shadowed call costs one branch
+class SmlGLInstrumentedFunctions : public QOpenGLFunctions_PROFILE
+{
+public:
+    enum Entry
+    {
+        UseProgram,
+        BindVertexArray,
+        BindBuffer,
+        BindBufferBase,
+        BindBufferRange,
+        BindFramebuffer,
+        ActiveTexture,
+        BindTexture,
+        BindTextureUnit,
+        BindSampler,
+        Enable,
+        Disable,
+        Viewport,
+        ClearColor,
+        FrontFace,
+        CullFace,
+        BlendFunc,
+        DepthMask,
+        ProgramUniform1i,
+        ProgramUniform1f,
+        ProgramUniform2fv,
+        ProgramUniform3fv,
+        ProgramUniform4fv,
+        ProgramUniformMatrix4fv,
+        Uniform1i,
+        Uniform1f,
+        Uniform3fv,
+        Uniform4fv,
+        UniformMatrix4fv,
+        Clear,
+        DrawArrays,
+        DrawElements,
+        DrawArraysInstanced,
+        DrawElementsInstanced,
+        LinkProgram,
+        DeleteProgram,
+
+        SML_GL_ENTRY_COUNT
+    };
+
+private:
+    inline static constexpr GLuint SML_UNKNOWN = ~0u;
+    inline static constexpr int SML_TEXTURE_UNITS = 32;
+    inline static constexpr int SML_UNIFORM_BINDINGS = 16;
+    inline static constexpr int SML_CAPS = 8;
+    inline static constexpr size_t SML_MAX_UNIFORM_BYTES = 64; //a mat4, larger arrays are only counted
+
+    //what the shadowed calls have set, SML_UNKNOWN after InvalidateGLState
+    struct ShadowState
+    {
+        GLuint program;
+        GLuint vao;
+        GLuint arrayBuffer;
+        GLuint elementBuffer; //part of the vao
+        GLuint uniformBuffer;
+        GLuint uniformBindings[SML_UNIFORM_BINDINGS];
+        GLintptr uniformOffsets[SML_UNIFORM_BINDINGS];
+        GLsizeiptr uniformSizes[SML_UNIFORM_BINDINGS]; //0 for a whole buffer bind
+        GLuint drawFramebuffer;
+        GLuint readFramebuffer;
+        GLuint activeTexture;
+        GLuint texture2D[SML_TEXTURE_UNITS];
+        GLuint samplers[SML_TEXTURE_UNITS];
+        GLenum caps[SML_CAPS];
+        GLuint capsOn[SML_CAPS];
+        GLint viewport[4];
+        bool viewportKnown;
+        GLfloat clearColor[4];
+        bool clearColorKnown;
+        GLuint frontFace;
+        GLuint cullFace;
+        GLuint blendSrc;
+        GLuint blendDst;
+        GLuint depthMask;
+    };
+
+    struct UniformValue
+    {
+        size_t bytes{ 0 };
+        unsigned char data[SML_MAX_UNIFORM_BYTES];
+    };
+
+    bool _glInstrumented{ false }; //render thread, changed between frames only
+    ShadowState _glState;
+    //uniforms are program state, they survive binds and foreign code, only a relink drops them
+    std::unordered_map<quint64, UniformValue> _glUniforms;
+    SmlGLCallCount _glFrame[SML_GL_ENTRY_COUNT];
+
+    //published at GLFrameEnd, read from any thread
+    mutable QMutex _glStatsMutex;
+    SmlGLCallStats _glStats;
+
+private:
+    static const char* EntryName(Entry entry);
+
+    void CountCall(Entry entry, bool redundant)
+    {
+        ++_glFrame[entry].calls;
+        _glFrame[entry].redundant += redundant;
+    }
+
+    static bool TrackValue(GLuint& slot, GLuint value)
+    {
+        bool same = slot == value;
+        slot = value;
+        return same;
+    }
+
+    GLuint* BufferSlot(GLenum target);
+    bool TrackCap(GLenum cap, GLuint on);
+    bool TrackUniform(GLuint program, GLint location, const void* data, size_t bytes);
+    bool TrackCurrentUniform(GLint location, const void* data, size_t bytes)
+    {
+        return SML_UNKNOWN != _glState.program && TrackUniform(_glState.program, location, data, bytes);
+    }
+    void DropUniforms(GLuint program);
+
+protected:
+    //render thread, ctx current
+    //the instrumentation is switched between frames, GLFrameBegin starts counting a frame
+    //and forgets the bindings of the previous one, GLFrameEnd publishes it
+    void SetGLInstrumented(bool on);
+    bool IsGLInstrumented() const { return _glInstrumented; }
+    void GLFrameBegin();
+    void GLFrameEnd();
+    //call after code that changes gl state behind the shadowed functions (QPainter),
+    //otherwise the next bind of the old value is wrongly counted as redundant
+    void InvalidateGLState();
+    //call when the ctx is destroyed, object names get reused by the next one
+    void ResetGLState();
+
+public:
+    SmlGLInstrumentedFunctions();
+
+    //any thread
+    SmlGLCallStats GLCallStats() const;
+
+public:
+    /////////////////////////////////////////////////////////////////
+    //shadowed entry points
+    void glUseProgram(GLuint program)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(UseProgram, TrackValue(_glState.program, program));
+        }
+        QOpenGLFunctions_PROFILE::glUseProgram(program);
+    }
+
+    void glBindVertexArray(GLuint array)
+    {
+        if (_glInstrumented)
+        {
+            bool same = TrackValue(_glState.vao, array);
+            if (!same)
+            {
+                _glState.elementBuffer = SML_UNKNOWN;
+            }
+            CountCall(BindVertexArray, same);
+        }
+        QOpenGLFunctions_PROFILE::glBindVertexArray(array);
+    }
+
+    void glBindBuffer(GLenum target, GLuint buffer)
+    {
+        if (_glInstrumented)
+        {
+            GLuint* slot = BufferSlot(target);
+            CountCall(BindBuffer, slot && TrackValue(*slot, buffer));
+        }
+        QOpenGLFunctions_PROFILE::glBindBuffer(target, buffer);
+    }
+
+    void glBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        if (_glInstrumented)
+        {
+            bool same = false;
+            if (GL_UNIFORM_BUFFER == target && index < SML_UNIFORM_BINDINGS)
+            {
+                same = TrackValue(_glState.uniformBindings[index], buffer) && 0 == _glState.uniformSizes[index];
+                _glState.uniformOffsets[index] = 0;
+                _glState.uniformSizes[index] = 0;
+                _glState.uniformBuffer = buffer; //also binds the generic target
+            }
+            CountCall(BindBufferBase, same);
+        }
+        QOpenGLFunctions_PROFILE::glBindBufferBase(target, index, buffer);
+    }
+
+    void glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        if (_glInstrumented)
+        {
+            bool same = false;
+            if (GL_UNIFORM_BUFFER == target && index < SML_UNIFORM_BINDINGS)
+            {
+                same = TrackValue(_glState.uniformBindings[index], buffer)
+                    && _glState.uniformOffsets[index] == offset && _glState.uniformSizes[index] == size;
+                _glState.uniformOffsets[index] = offset;
+                _glState.uniformSizes[index] = size;
+                _glState.uniformBuffer = buffer;
+            }
+            CountCall(BindBufferRange, same);
+        }
+        QOpenGLFunctions_PROFILE::glBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    void glBindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        if (_glInstrumented)
+        {
+            bool same = false;
+            if (GL_FRAMEBUFFER == target)
+            {
+                same = _glState.drawFramebuffer == framebuffer && _glState.readFramebuffer == framebuffer;
+                _glState.drawFramebuffer = framebuffer;
+                _glState.readFramebuffer = framebuffer;
+            }
+            else
+            {
+                same = TrackValue(GL_READ_FRAMEBUFFER == target ? _glState.readFramebuffer : _glState.drawFramebuffer, framebuffer);
+            }
+            CountCall(BindFramebuffer, same);
+        }
+        QOpenGLFunctions_PROFILE::glBindFramebuffer(target, framebuffer);
+    }
+
+    void glActiveTexture(GLenum texture)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(ActiveTexture, TrackValue(_glState.activeTexture, texture));
+        }
+        QOpenGLFunctions_PROFILE::glActiveTexture(texture);
+    }
+
+    void glBindTexture(GLenum target, GLuint texture)
+    {
+        if (_glInstrumented)
+        {
+            bool same = false;
+            GLuint unit = _glState.activeTexture - GL_TEXTURE0;
+            if (GL_TEXTURE_2D == target && unit < SML_TEXTURE_UNITS)
+            {
+                same = TrackValue(_glState.texture2D[unit], texture);
+            }
+            CountCall(BindTexture, same);
+        }
+        QOpenGLFunctions_PROFILE::glBindTexture(target, texture);
+    }
+
+    void glBindTextureUnit(GLuint unit, GLuint texture)
+    {
+        if (_glInstrumented)
+        {
+            //binds whatever target the texture has, only 2d textures are used here
+            CountCall(BindTextureUnit, unit < SML_TEXTURE_UNITS && TrackValue(_glState.texture2D[unit], texture));
+        }
+        QOpenGLFunctions_PROFILE::glBindTextureUnit(unit, texture);
+    }
+
+    void glBindSampler(GLuint unit, GLuint sampler)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(BindSampler, unit < SML_TEXTURE_UNITS && TrackValue(_glState.samplers[unit], sampler));
+        }
+        QOpenGLFunctions_PROFILE::glBindSampler(unit, sampler);
+    }
+
+    void glEnable(GLenum cap)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(Enable, TrackCap(cap, 1));
+        }
+        QOpenGLFunctions_PROFILE::glEnable(cap);
+    }
+
+    void glDisable(GLenum cap)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(Disable, TrackCap(cap, 0));
+        }
+        QOpenGLFunctions_PROFILE::glDisable(cap);
+    }
+
+    void glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        if (_glInstrumented)
+        {
+            const GLint viewport[4]{ x, y, width, height };
+            bool same = _glState.viewportKnown && 0 == memcmp(_glState.viewport, viewport, sizeof(viewport));
+            memcpy(_glState.viewport, viewport, sizeof(viewport));
+            _glState.viewportKnown = true;
+            CountCall(Viewport, same);
+        }
+        QOpenGLFunctions_PROFILE::glViewport(x, y, width, height);
+    }
+
+    void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+    {
+        if (_glInstrumented)
+        {
+            const GLfloat color[4]{ red, green, blue, alpha };
+            bool same = _glState.clearColorKnown && 0 == memcmp(_glState.clearColor, color, sizeof(color));
+            memcpy(_glState.clearColor, color, sizeof(color));
+            _glState.clearColorKnown = true;
+            CountCall(ClearColor, same);
+        }
+        QOpenGLFunctions_PROFILE::glClearColor(red, green, blue, alpha);
+    }
+
+    void glFrontFace(GLenum mode)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(FrontFace, TrackValue(_glState.frontFace, mode));
+        }
+        QOpenGLFunctions_PROFILE::glFrontFace(mode);
+    }
+
+    void glCullFace(GLenum mode)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(CullFace, TrackValue(_glState.cullFace, mode));
+        }
+        QOpenGLFunctions_PROFILE::glCullFace(mode);
+    }
+
+    void glBlendFunc(GLenum sfactor, GLenum dfactor)
+    {
+        if (_glInstrumented)
+        {
+            bool same = TrackValue(_glState.blendSrc, sfactor);
+            same = TrackValue(_glState.blendDst, dfactor) && same;
+            CountCall(BlendFunc, same);
+        }
+        QOpenGLFunctions_PROFILE::glBlendFunc(sfactor, dfactor);
+    }
+
+    void glDepthMask(GLboolean flag)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(DepthMask, TrackValue(_glState.depthMask, flag));
+        }
+        QOpenGLFunctions_PROFILE::glDepthMask(flag);
+    }
+
+    /////////////////////////////////////////////////////////////////
+    void glProgramUniform1i(GLuint program, GLint location, GLint v0)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(ProgramUniform1i, TrackUniform(program, location, &v0, sizeof(v0)));
+        }
+        QOpenGLFunctions_PROFILE::glProgramUniform1i(program, location, v0);
+    }
+
+    void glProgramUniform1f(GLuint program, GLint location, GLfloat v0)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(ProgramUniform1f, TrackUniform(program, location, &v0, sizeof(v0)));
+        }
+        QOpenGLFunctions_PROFILE::glProgramUniform1f(program, location, v0);
+    }
+
+    void glProgramUniform2fv(GLuint program, GLint location, GLsizei count, const GLfloat* value)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(ProgramUniform2fv, TrackUniform(program, location, value, sizeof(GLfloat) * 2 * count));
+        }
+        QOpenGLFunctions_PROFILE::glProgramUniform2fv(program, location, count, value);
+    }
+
+    void glProgramUniform3fv(GLuint program, GLint location, GLsizei count, const GLfloat* value)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(ProgramUniform3fv, TrackUniform(program, location, value, sizeof(GLfloat) * 3 * count));
+        }
+        QOpenGLFunctions_PROFILE::glProgramUniform3fv(program, location, count, value);
+    }
+
+    void glProgramUniform4fv(GLuint program, GLint location, GLsizei count, const GLfloat* value)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(ProgramUniform4fv, TrackUniform(program, location, value, sizeof(GLfloat) * 4 * count));
+        }
+        QOpenGLFunctions_PROFILE::glProgramUniform4fv(program, location, count, value);
+    }
+
+    void glProgramUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        if (_glInstrumented)
+        {
+            //the transpose flag is not part of the stored value, nobody mixes both for one uniform
+            CountCall(ProgramUniformMatrix4fv, TrackUniform(program, location, value, sizeof(GLfloat) * 16 * count));
+        }
+        QOpenGLFunctions_PROFILE::glProgramUniformMatrix4fv(program, location, count, transpose, value);
+    }
+
+    void glUniform1i(GLint location, GLint v0)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(Uniform1i, TrackCurrentUniform(location, &v0, sizeof(v0)));
+        }
+        QOpenGLFunctions_PROFILE::glUniform1i(location, v0);
+    }
+
+    void glUniform1f(GLint location, GLfloat v0)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(Uniform1f, TrackCurrentUniform(location, &v0, sizeof(v0)));
+        }
+        QOpenGLFunctions_PROFILE::glUniform1f(location, v0);
+    }
+
+    void glUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(Uniform3fv, TrackCurrentUniform(location, value, sizeof(GLfloat) * 3 * count));
+        }
+        QOpenGLFunctions_PROFILE::glUniform3fv(location, count, value);
+    }
+
+    void glUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(Uniform4fv, TrackCurrentUniform(location, value, sizeof(GLfloat) * 4 * count));
+        }
+        QOpenGLFunctions_PROFILE::glUniform4fv(location, count, value);
+    }
+
+    void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(UniformMatrix4fv, TrackCurrentUniform(location, value, sizeof(GLfloat) * 16 * count));
+        }
+        QOpenGLFunctions_PROFILE::glUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    /////////////////////////////////////////////////////////////////
+    void glClear(GLbitfield mask)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(Clear, false);
+        }
+        QOpenGLFunctions_PROFILE::glClear(mask);
+    }
+
+    void glDrawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(DrawArrays, false);
+        }
+        QOpenGLFunctions_PROFILE::glDrawArrays(mode, first, count);
+    }
+
+    void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(DrawElements, false);
+        }
+        QOpenGLFunctions_PROFILE::glDrawElements(mode, count, type, indices);
+    }
+
+    void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(DrawArraysInstanced, false);
+        }
+        QOpenGLFunctions_PROFILE::glDrawArraysInstanced(mode, first, count, instancecount);
+    }
+
+    void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)
+    {
+        if (_glInstrumented)
+        {
+            CountCall(DrawElementsInstanced, false);
+        }
+        QOpenGLFunctions_PROFILE::glDrawElementsInstanced(mode, count, type, indices, instancecount);
+    }
+
+    /////////////////////////////////////////////////////////////////
+    //not per frame, shadowed so the uniform values of a relinked or deleted program are dropped
+    void glLinkProgram(GLuint program)
+    {
+        DropUniforms(program);
+        if (_glInstrumented)
+        {
+            CountCall(LinkProgram, false);
+        }
+        QOpenGLFunctions_PROFILE::glLinkProgram(program);
+    }
+
+    void glDeleteProgram(GLuint program)
+    {
+        DropUniforms(program);
+        if (_glInstrumented)
+        {
+            CountCall(DeleteProgram, false);
+        }
+        QOpenGLFunctions_PROFILE::glDeleteProgram(program);
+    }
+};
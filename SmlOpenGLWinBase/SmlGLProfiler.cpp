@@ -0,0 +1,187 @@
+#include "SmlGLProfiler.h"
+#include "SmlFramePacer.h"
+
+#include <QMutexLocker>
+#include <cstring>
+
+
+static double SmlEmaMs(double average, double sample)
+{
+    return 0 == average ? sample : average + (sample - average) / 8;
+}
+
+void SmlGLProfiler::Create(QOpenGLFunctions_PROFILE* gl)
+{
+    if (_gl)
+    {
+        return;
+    }
+
+    _gl = gl;
+    for (Frame& frame : _frames)
+    {
+        _gl->glGenQueries(SML_MAX_SCOPES * 2, frame.queries);
+        frame.count = 0;
+        frame.pending = false;
+    }
+    _frameIndex = 0;
+    _current = nullptr;
+}
+
+void SmlGLProfiler::Destroy()
+{
+    if (nullptr == _gl)
+    {
+        return;
+    }
+
+    for (Frame& frame : _frames)
+    {
+        _gl->glDeleteQueries(SML_MAX_SCOPES * 2, frame.queries);
+        frame.count = 0;
+        frame.pending = false;
+    }
+    _gl = nullptr;
+    _current = nullptr;
+}
+
+bool SmlGLProfiler::TryResolve(Frame& frame)
+{
+    if (0 == frame.count)
+    {
+        frame.pending = false;
+        return true;
+    }
+
+    //timestamps complete in submission order, the last one being there means all are
+    GLint available = GL_FALSE;
+    _gl->glGetQueryObjectiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (GL_FALSE == available)
+    {
+        return false;
+    }
+
+    GLuint64 stamps[SML_MAX_SCOPES * 2];
+    for (int ii = 0; ii < frame.count * 2; ++ii)
+    {
+        _gl->glGetQueryObjectui64v(frame.queries[ii], GL_QUERY_RESULT, &stamps[ii]);
+    }
+
+    QMutexLocker<QMutex> locker{ &_mutex };
+    for (int ii = 0; ii < frame.count; ++ii)
+    {
+        const Scope& scope = frame.scopes[ii];
+
+        auto it = _timings.begin();
+        for (; it != _timings.end(); ++it)
+        {
+            if (it->name == scope.name || 0 == std::strcmp(it->name, scope.name))
+            {
+                break;
+            }
+        }
+        if (it == _timings.end())
+        {
+            it = _timings.insert(it, SmlGLScopeTiming{ scope.name, scope.depth });
+        }
+
+        it->depth = scope.depth;
+        it->cpuMs = (scope.cpuEndNs - scope.cpuBeginNs) / 1e6;
+        it->gpuMs = (stamps[ii * 2 + 1] - stamps[ii * 2]) / 1e6;
+        it->cpuAvgMs = SmlEmaMs(it->cpuAvgMs, it->cpuMs);
+        it->gpuAvgMs = SmlEmaMs(it->gpuAvgMs, it->gpuMs);
+    }
+    ++_framesResolved;
+
+    frame.pending = false;
+    return true;
+}
+
+void SmlGLProfiler::BeginFrame()
+{
+    if (nullptr == _gl)
+    {
+        return;
+    }
+
+    //oldest first, stop at the first one the gpu has not reached yet
+    for (quint64 ii = _frameIndex >= SML_PROFILER_LATENCY ? _frameIndex - SML_PROFILER_LATENCY : 0; ii < _frameIndex; ++ii)
+    {
+        Frame& frame = _frames[ii % SML_PROFILER_LATENCY];
+        if (frame.pending && !TryResolve(frame))
+        {
+            break;
+        }
+    }
+
+    _current = &_frames[_frameIndex % SML_PROFILER_LATENCY];
+    if (_current->pending)
+    {
+        QMutexLocker<QMutex> locker{ &_mutex };
+        ++_framesSkipped; //reusing the queries drops the old results
+    }
+    _current->count = 0;
+    _current->pending = false;
+    _depth = 0;
+}
+
+void SmlGLProfiler::EndFrame()
+{
+    if (nullptr == _current)
+    {
+        return;
+    }
+
+    _current->pending = _current->count > 0;
+    _current = nullptr;
+    ++_frameIndex;
+}
+
+int SmlGLProfiler::ScopeBegin(const char* name)
+{
+    if (nullptr == _current || _current->count >= SML_MAX_SCOPES)
+    {
+        return -1;
+    }
+
+    int index = _current->count++;
+    Scope& scope = _current->scopes[index];
+    scope.name = name;
+    scope.depth = _depth++;
+    scope.cpuBeginNs = SmlFramePacer::NowNs();
+    scope.cpuEndNs = scope.cpuBeginNs;
+    _current->lastQuery = _current->queries[index * 2];
+    _gl->glQueryCounter(_current->lastQuery, GL_TIMESTAMP);
+    return index;
+}
+
+void SmlGLProfiler::ScopeEnd(int scope)
+{
+    if (nullptr == _current || scope < 0)
+    {
+        return;
+    }
+
+    _current->lastQuery = _current->queries[scope * 2 + 1];
+    _gl->glQueryCounter(_current->lastQuery, GL_TIMESTAMP);
+    _current->scopes[scope].cpuEndNs = SmlFramePacer::NowNs();
+    --_depth;
+}
+
+std::vector<SmlGLScopeTiming> SmlGLProfiler::Timings() const
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    return _timings;
+}
+
+quint64 SmlGLProfiler::FramesResolved() const
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    return _framesResolved;
+}
+
+quint64 SmlGLProfiler::FramesSkipped() const
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    return _framesSkipped;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+
+#include <vector>
+
+#include "SmlGLFunctions.h"
+
+struct SmlGLScopeTiming
+{
+    const char* name{ nullptr };
+    int depth{ 0 };         //nesting level inside the frame
+    double cpuMs{ 0 };      //latest resolved frame
+    double gpuMs{ 0 };
+    double cpuAvgMs{ 0 };
+    double gpuAvgMs{ 0 };
+};
+
+//gpu and cpu time of named scopes on the render thread
+//every scope is bracketed by two GL_TIMESTAMP queries (GL_TIME_ELAPSED can not nest),
+//the queries of a frame are read SML_PROFILER_LATENCY frames later and only once they
+//are available, a frame whose results are still not there when its slot comes around
+//again is skipped instead of waited for
+class SmlGLProfiler final
+{
+private:
+    inline static constexpr int SML_PROFILER_LATENCY = 4;
+    inline static constexpr int SML_MAX_SCOPES = 16;
+
+    struct Scope
+    {
+        const char* name{ nullptr };
+        int depth{ 0 };
+        qint64 cpuBeginNs{ 0 };
+        qint64 cpuEndNs{ 0 };
+    };
+
+    struct Frame
+    {
+        GLuint queries[SML_MAX_SCOPES * 2]{};
+        Scope scopes[SML_MAX_SCOPES];
+        int count{ 0 };
+        GLuint lastQuery{ 0 }; //issued last, nested scopes end out of index order
+        bool pending{ false };
+    };
+
+    //render thread
+    QOpenGLFunctions_PROFILE* _gl{ nullptr };
+    Frame _frames[SML_PROFILER_LATENCY];
+    quint64 _frameIndex{ 0 };
+    Frame* _current{ nullptr };
+    int _depth{ 0 };
+
+    //resolved results, read from any thread
+    mutable QMutex _mutex;
+    std::vector<SmlGLScopeTiming> _timings;
+    quint64 _framesResolved{ 0 };
+    quint64 _framesSkipped{ 0 };
+
+private:
+    bool TryResolve(Frame& frame);
+
+public:
+    SmlGLProfiler() = default;
+    SmlGLProfiler(const SmlGLProfiler&) = delete;
+    SmlGLProfiler& operator=(const SmlGLProfiler&) = delete;
+
+    //render thread, ctx current
+    void Create(QOpenGLFunctions_PROFILE* gl);
+    void Destroy();
+    bool IsCreated() const { return nullptr != _gl; }
+
+    void BeginFrame();
+    void EndFrame();
+
+    //-1 when the profiler is off or the scope table is full, ScopeEnd ignores -1
+    int ScopeBegin(const char* name);
+    void ScopeEnd(int scope);
+
+    //any thread
+    std::vector<SmlGLScopeTiming> Timings() const;
+    quint64 FramesResolved() const;
+    quint64 FramesSkipped() const;
+};
+
+
+//brackets the enclosing block, name must outlive the profiler (a string literal)
+class SmlGLProfileScope final
+{
+private:
+    SmlGLProfiler& _profiler;
+    int _scope{ -1 };
+
+public:
+    SmlGLProfileScope(SmlGLProfiler& profiler, const char* name) :
+        _profiler{ profiler },
+        _scope{ profiler.ScopeBegin(name) }
+    {
+    }
+
+    ~SmlGLProfileScope()
+    {
+        _profiler.ScopeEnd(_scope);
+    }
+
+    SmlGLProfileScope(const SmlGLProfileScope&) = delete;
+    SmlGLProfileScope& operator=(const SmlGLProfileScope&) = delete;
+};
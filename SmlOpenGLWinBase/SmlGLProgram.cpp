@@ -0,0 +1,194 @@
+#include "SmlGLProgram.h"
+
+#include <QDebug>
+
+bool SmlGLIsSamplerType(GLenum type)
+{
+    switch (type)
+    {
+    case GL_SAMPLER_1D:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_2D_SHADOW:
+    case GL_SAMPLER_1D_ARRAY:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_CUBE_MAP_ARRAY:
+    case GL_SAMPLER_2D_MULTISAMPLE:
+    case GL_SAMPLER_2D_RECT:
+    case GL_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_2D:
+    case GL_INT_SAMPLER_3D:
+    case GL_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D:
+    case GL_UNSIGNED_INT_SAMPLER_3D:
+    case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static QByteArray ResourceName(QOpenGLFunctions_PROFILE* gl, GLuint id, GLenum iface, GLuint index, QByteArray& buffer)
+{
+    GLsizei length = 0;
+    gl->glGetProgramResourceName(id, iface, index, GLsizei(buffer.size()), &length, buffer.data());
+    QByteArray name{ buffer.constData(), length };
+    if (name.endsWith("[0]"))
+    {
+        name.chop(3);
+    }
+    return name;
+}
+
+void SmlGLProgram::Reflect(QOpenGLFunctions_PROFILE* gl, GLuint id)
+{
+    _id = id;
+    _uniforms.clear();
+    _blocks.clear();
+    _attributes.clear();
+
+    GLint linked = GL_FALSE;
+    gl->glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    _linked = GL_TRUE == linked;
+    if (!_linked)
+    {
+        return; //every lookup warns and hands out an inert handle
+    }
+
+    GLint count = 0;
+    GLint maxName = 0;
+    QByteArray buffer;
+
+    /////////////////////////////////////////////////////////////////
+    gl->glGetProgramInterfaceiv(id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+    gl->glGetProgramInterfaceiv(id, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxName);
+    buffer.resize(qMax(maxName, 1));
+    for (GLint ii = 0; ii < count; ++ii)
+    {
+        const GLenum props[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+        GLint values[4]{};
+        gl->glGetProgramResourceiv(id, GL_UNIFORM, ii, 4, props, 4, nullptr, values);
+        if (-1 != values[3])
+        {
+            continue; //block member
+        }
+
+        Resource uniform;
+        uniform.name = ResourceName(gl, id, GL_UNIFORM, ii, buffer);
+        uniform.type = GLenum(values[0]);
+        uniform.location = values[1];
+        uniform.arraySize = values[2];
+        if (SmlGLIsSamplerType(uniform.type))
+        {
+            gl->glGetUniformiv(id, uniform.location, &uniform.binding); //layout(binding = ...) or 0
+        }
+        _uniforms.push_back(uniform);
+    }
+
+    /////////////////////////////////////////////////////////////////
+    gl->glGetProgramInterfaceiv(id, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+    gl->glGetProgramInterfaceiv(id, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &maxName);
+    buffer.resize(qMax(maxName, 1));
+    for (GLint ii = 0; ii < count; ++ii)
+    {
+        const GLenum props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+        GLint values[2]{};
+        gl->glGetProgramResourceiv(id, GL_UNIFORM_BLOCK, ii, 2, props, 2, nullptr, values);
+
+        Resource block;
+        block.name = ResourceName(gl, id, GL_UNIFORM_BLOCK, ii, buffer);
+        block.location = ii; //the block index
+        block.binding = values[0];
+        block.dataSize = values[1];
+        _blocks.push_back(block);
+    }
+
+    /////////////////////////////////////////////////////////////////
+    gl->glGetProgramInterfaceiv(id, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+    gl->glGetProgramInterfaceiv(id, GL_PROGRAM_INPUT, GL_MAX_NAME_LENGTH, &maxName);
+    buffer.resize(qMax(maxName, 1));
+    for (GLint ii = 0; ii < count; ++ii)
+    {
+        const GLenum props[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE };
+        GLint values[3]{};
+        gl->glGetProgramResourceiv(id, GL_PROGRAM_INPUT, ii, 3, props, 3, nullptr, values);
+        if (-1 == values[1])
+        {
+            continue; //gl_VertexID and friends
+        }
+
+        Resource attribute;
+        attribute.name = ResourceName(gl, id, GL_PROGRAM_INPUT, ii, buffer);
+        attribute.type = GLenum(values[0]);
+        attribute.location = values[1];
+        attribute.arraySize = values[2];
+        _attributes.push_back(attribute);
+    }
+}
+
+const SmlGLProgram::Resource* SmlGLProgram::Find(const std::vector<Resource>& resources, const char* name)
+{
+    for (const Resource& resource : resources)
+    {
+        if (resource.name == name)
+        {
+            return &resource;
+        }
+    }
+    return nullptr;
+}
+
+void SmlGLProgram::Warn(const char* kind, const char* name, const Resource* found) const
+{
+    if (!_linked)
+    {
+        qWarning() << "SmlGLProgram:" << kind << name << "requested from a program that did not link";
+    }
+    else if (found)
+    {
+        qWarning() << "SmlGLProgram:" << kind << name << "has glsl type" << "0x" + QByteArray::number(found->type, 16) << "not matching the handle";
+    }
+    else
+    {
+        qWarning() << "SmlGLProgram:" << kind << name << "is not active in program" << _id;
+    }
+}
+
+SmlGLUniformBlock SmlGLProgram::Block(const char* name, GLsizeiptr hostSize) const
+{
+    SmlGLUniformBlock block;
+    const Resource* found = Find(_blocks, name);
+    if (nullptr == found)
+    {
+        Warn("block", name, found);
+        return block;
+    }
+
+    if (hostSize && hostSize != found->dataSize)
+    {
+        qWarning() << "SmlGLProgram: block" << name << "is" << found->dataSize << "bytes in glsl," << hostSize << "in c++";
+    }
+
+    block.index = GLuint(found->location);
+    block.binding = GLuint(found->binding);
+    block.dataSize = found->dataSize;
+    return block;
+}
+
+SmlGLAttribute SmlGLProgram::Attribute(const char* name) const
+{
+    SmlGLAttribute attribute;
+    const Resource* found = Find(_attributes, name);
+    if (nullptr == found)
+    {
+        Warn("attribute", name, found);
+        return attribute;
+    }
+
+    attribute.location = GLuint(found->location);
+    attribute.type = found->type;
+    return attribute;
+}
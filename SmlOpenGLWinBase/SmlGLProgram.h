@@ -0,0 +1,121 @@
+#pragma once
+
+#include <QByteArray>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "SmlGLFunctions.h"
+
+//value of a sampler uniform, the texture unit
+struct SmlGLSampler
+{
+    GLint unit{ 0 };
+};
+
+bool SmlGLIsSamplerType(GLenum type);
+
+//which glsl types a handle of T may refer to
+template<typename T> struct SmlGLUniformTraits;
+template<> struct SmlGLUniformTraits<GLint> { static bool Accepts(GLenum type) { return GL_INT == type; } };
+template<> struct SmlGLUniformTraits<GLfloat> { static bool Accepts(GLenum type) { return GL_FLOAT == type; } };
+template<> struct SmlGLUniformTraits<glm::vec2> { static bool Accepts(GLenum type) { return GL_FLOAT_VEC2 == type; } };
+template<> struct SmlGLUniformTraits<glm::vec3> { static bool Accepts(GLenum type) { return GL_FLOAT_VEC3 == type; } };
+template<> struct SmlGLUniformTraits<glm::vec4> { static bool Accepts(GLenum type) { return GL_FLOAT_VEC4 == type; } };
+template<> struct SmlGLUniformTraits<glm::mat4> { static bool Accepts(GLenum type) { return GL_FLOAT_MAT4 == type; } };
+template<> struct SmlGLUniformTraits<SmlGLSampler> { static bool Accepts(GLenum type) { return SmlGLIsSamplerType(type); } };
+
+//resolved at link time, set with SmlGLWindow::SetUniform; a handle that did not resolve
+//still has the program id with location -1, gl silently ignores uniform writes to -1 on a
+//linked program, so neither SetUniform nor the frame loop checks it
+template<typename T>
+struct SmlGLUniform
+{
+    GLuint program{ 0 };
+    GLint location{ -1 };
+
+    bool IsValid() const { return -1 != location; }
+};
+
+//a block or attribute that did not resolve keeps GL_INVALID_INDEX, which gl rejects;
+//SmlGLWindow::BindUniformBlock and SetVertexAttribute skip it
+struct SmlGLUniformBlock
+{
+    GLuint index{ GL_INVALID_INDEX };
+    GLuint binding{ GL_INVALID_INDEX }; //layout(binding = ...), the index for glBindBufferRange
+    GLint dataSize{ 0 };                //std140 size the shader expects
+
+    bool IsValid() const { return GL_INVALID_INDEX != index; }
+};
+
+struct SmlGLAttribute
+{
+    GLuint location{ GL_INVALID_INDEX }; //attrib and binding index for the glVertexArray* calls
+    GLenum type{ 0 };
+
+    bool IsValid() const { return GL_INVALID_INDEX != location; }
+};
+
+
+//a linked program and what it exposes, introspected once with glGetProgramResource*
+//lookups by name are meant for GLInitialize and program reloads, they warn when a name
+//is not active or has another type than the handle asks for
+class SmlGLProgram final
+{
+public:
+    struct Resource
+    {
+        QByteArray name;     //arrays without the [0]
+        GLenum type{ 0 };    //0 for blocks
+        GLint location{ -1 }; //uniforms and attributes
+        GLint arraySize{ 1 };
+        GLint binding{ -1 };  //sampler unit or block binding
+        GLint dataSize{ 0 };  //blocks
+    };
+
+private:
+    GLuint _id{ 0 };
+    bool _linked{ false };
+    std::vector<Resource> _uniforms; //default block only, block members are written through the block
+    std::vector<Resource> _blocks;
+    std::vector<Resource> _attributes;
+
+private:
+    static const Resource* Find(const std::vector<Resource>& resources, const char* name);
+    void Warn(const char* kind, const char* name, const Resource* found) const;
+
+public:
+    SmlGLProgram() = default;
+
+    //ctx current, after glLinkProgram
+    void Reflect(QOpenGLFunctions_PROFILE* gl, GLuint id);
+
+    GLuint Id() const { return _id; }
+    bool IsLinked() const { return _linked; }
+
+    template<typename T>
+    SmlGLUniform<T> Uniform(const char* name) const
+    {
+        SmlGLUniform<T> handle;
+        handle.program = _id; //also when not found, see SmlGLUniform
+        const Resource* found = Find(_uniforms, name);
+        if (found && SmlGLUniformTraits<T>::Accepts(found->type))
+        {
+            handle.location = found->location;
+        }
+        else
+        {
+            Warn("uniform", name, found);
+        }
+        return handle;
+    }
+
+    //hostSize is sizeof the c++ mirror of the block, 0 skips the size check
+    SmlGLUniformBlock Block(const char* name, GLsizeiptr hostSize = 0) const;
+    SmlGLAttribute Attribute(const char* name) const;
+
+    const std::vector<Resource>& Uniforms() const { return _uniforms; }
+    const std::vector<Resource>& Blocks() const { return _blocks; }
+    const std::vector<Resource>& Attributes() const { return _attributes; }
+};
@@ -0,0 +1,177 @@
+#include "SmlGLProgramCache.h"
+
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <cstring>
+
+//file layout: header, then the binary as glGetProgramBinary returned it
+struct SmlGLProgramBinaryHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 format; //binaryFormat of glGetProgramBinary
+    quint32 length;
+};
+
+static constexpr char SML_PROGRAM_MAGIC[4] = { 'S', 'M', 'L', 'P' };
+static constexpr quint32 SML_PROGRAM_VERSION = 1;
+
+SmlGLProgramCache::SmlGLProgramCache(const QString& dir) :
+    _dir{ dir }
+{
+    if (_dir.isEmpty())
+    {
+        _dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/programs";
+    }
+}
+
+bool SmlGLProgramCache::Open(QOpenGLFunctions_PROFILE* gl)
+{
+    if (_opened)
+    {
+        return _usable;
+    }
+    _opened = true;
+
+    GLint formats = 0;
+    gl->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    _usable = formats > 0;
+    if (!_usable)
+    {
+        qWarning() << "SmlGLProgramCache: the driver offers no program binary format, every program is compiled";
+        return false;
+    }
+
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        _driver += reinterpret_cast<const char*>(gl->glGetString(name));
+        _driver += '\n';
+    }
+    return true;
+}
+
+QString SmlGLProgramCache::FilePath(const QByteArray& key) const
+{
+    return _dir + "/" + QString::fromLatin1(key) + ".bin";
+}
+
+QByteArray SmlGLProgramCache::Key(const GLchar* const sources[], int count) const
+{
+    QCryptographicHash hash{ QCryptographicHash::Sha1 };
+    hash.addData(_driver);
+    for (int ii = 0; ii < count; ++ii)
+    {
+        //stage separator, so a missing geometry shader can not alias a shifted source
+        const char stage[2] = { '\0', char('0' + ii) };
+        hash.addData(stage, sizeof(stage));
+        if (sources[ii])
+        {
+            hash.addData(sources[ii], int(strlen(sources[ii])));
+        }
+    }
+    return hash.result().toHex();
+}
+
+GLuint SmlGLProgramCache::Load(QOpenGLFunctions_PROFILE* gl, const QByteArray& key)
+{
+    QFile file{ FilePath(key) };
+    if (!file.open(QFile::ReadOnly))
+    {
+        return 0;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    SmlGLProgramBinaryHeader header;
+    bool valid = data.size() >= int(sizeof(header));
+    if (valid)
+    {
+        memcpy(&header, data.constData(), sizeof(header));
+        valid = 0 == memcmp(header.magic, SML_PROGRAM_MAGIC, sizeof(header.magic))
+            && SML_PROGRAM_VERSION == header.version
+            && data.size() - int(sizeof(header)) == int(header.length);
+    }
+
+    GLuint programId = 0;
+    if (valid)
+    {
+        programId = gl->glCreateProgram();
+        gl->glProgramBinary(programId, header.format, data.constData() + sizeof(header), GLsizei(header.length));
+
+        GLint linked = GL_FALSE;
+        gl->glGetProgramiv(programId, GL_LINK_STATUS, &linked);
+        if (GL_TRUE != linked)
+        {
+            gl->glDeleteProgram(programId);
+            programId = 0;
+        }
+    }
+
+    if (0 == programId)
+    {
+        QFile::remove(file.fileName()); //rewritten by the Store after the compile
+        QMutexLocker locker{ &_statsMutex };
+        ++_stats.rejected;
+    }
+    return programId;
+}
+
+void SmlGLProgramCache::Store(QOpenGLFunctions_PROFILE* gl, const QByteArray& key, GLuint programId)
+{
+    GLint linked = GL_FALSE;
+    gl->glGetProgramiv(programId, GL_LINK_STATUS, &linked);
+    GLint length = 0;
+    gl->glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (GL_TRUE != linked || length <= 0)
+    {
+        return;
+    }
+
+    QByteArray data{ int(sizeof(SmlGLProgramBinaryHeader)) + length, Qt::Uninitialized };
+    SmlGLProgramBinaryHeader header;
+    memcpy(header.magic, SML_PROGRAM_MAGIC, sizeof(header.magic));
+    header.version = SML_PROGRAM_VERSION;
+    GLenum format = 0;
+    GLsizei written = 0;
+    gl->glGetProgramBinary(programId, length, &written, &format, data.data() + sizeof(header));
+    header.format = format;
+    header.length = quint32(written);
+    memcpy(data.data(), &header, sizeof(header));
+    data.truncate(int(sizeof(header)) + written);
+
+    //QSaveFile renames on commit, a reader never sees half a binary
+    QDir{}.mkpath(_dir);
+    QSaveFile file{ FilePath(key) };
+    if (!file.open(QFile::WriteOnly) || file.write(data) != data.size() || !file.commit())
+    {
+        qWarning() << "SmlGLProgramCache: can not write" << file.fileName();
+    }
+}
+
+void SmlGLProgramCache::Record(bool hit, qint64 elapsedNs)
+{
+    double ms = elapsedNs / 1e6;
+    QMutexLocker locker{ &_statsMutex };
+    if (hit)
+    {
+        ++_stats.hits;
+        _stats.hitMs += ms;
+    }
+    else
+    {
+        ++_stats.misses;
+        _stats.missMs += ms;
+    }
+}
+
+SmlGLProgramCacheStats SmlGLProgramCache::Stats() const
+{
+    QMutexLocker locker{ &_statsMutex };
+    return _stats;
+}
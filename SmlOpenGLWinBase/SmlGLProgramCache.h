@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QMutex>
+#include <QtGlobal>
+
+#include "SmlGLFunctions.h"
+
+struct SmlGLProgramCacheStats
+{
+    quint64 hits{ 0 };
+    quint64 misses{ 0 };   //compiled from source, includes the binaries the driver rejected
+    quint64 rejected{ 0 }; //stale binaries, e.g. after a driver update that kept the version string
+    double hitMs{ 0 };     //summed CreateProgram times
+    double missMs{ 0 };
+};
+
+//linked program binaries on disk (glGetProgramBinary / glProgramBinary), one file per
+//program keyed by a sha1 of the driver strings and the full source of every stage, so
+//any define or include expanded into the source gives a new key; a binary the driver
+//does not take back is deleted and the program is compiled from source again
+class SmlGLProgramCache final
+{
+private:
+    QString _dir;
+    QByteArray _driver; //vendor, renderer and version strings
+    bool _opened{ false };
+    bool _usable{ false }; //the driver has at least one binary format
+
+    mutable QMutex _statsMutex;
+    SmlGLProgramCacheStats _stats;
+
+private:
+    QString FilePath(const QByteArray& key) const;
+
+public:
+    //any thread; an empty dir means <cache location>/programs
+    explicit SmlGLProgramCache(const QString& dir = QString());
+
+    SmlGLProgramCache(const SmlGLProgramCache&) = delete;
+    SmlGLProgramCache& operator=(const SmlGLProgramCache&) = delete;
+
+    //render thread, ctx current; reads the driver strings on the first call
+    bool Open(QOpenGLFunctions_PROFILE* gl);
+
+    QByteArray Key(const GLchar* const sources[], int count) const;
+    //a linked program, 0 on a miss
+    GLuint Load(QOpenGLFunctions_PROFILE* gl, const QByteArray& key);
+    //the program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    void Store(QOpenGLFunctions_PROFILE* gl, const QByteArray& key, GLuint programId);
+    void Record(bool hit, qint64 elapsedNs);
+
+    //any thread
+    SmlGLProgramCacheStats Stats() const;
+    const QString& Dir() const { return _dir; }
+};
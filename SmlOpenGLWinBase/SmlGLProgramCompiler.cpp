@@ -0,0 +1,275 @@
+#include "SmlGLProgramCompiler.h"
+#include "SmlGLProgramCache.h"
+#include "SmlTrace.h"
+
+#include <QOpenGLContext>
+#include <QDebug>
+
+#include <cstring>
+
+void SmlGLProgramCompiler::Open()
+{
+    _opened = true;
+
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    if (nullptr == ctx)
+    {
+        return;
+    }
+
+    //both let the driver pick the thread count with 0xFFFFFFFF
+    using SmlMaxShaderCompilerThreads = void (QOPENGLF_APIENTRYP)(GLuint count);
+    SmlMaxShaderCompilerThreads maxThreads = nullptr;
+    if (ctx->hasExtension(QByteArrayLiteral("GL_KHR_parallel_shader_compile")))
+    {
+        maxThreads = reinterpret_cast<SmlMaxShaderCompilerThreads>(ctx->getProcAddress("glMaxShaderCompilerThreadsKHR"));
+    }
+    else if (ctx->hasExtension(QByteArrayLiteral("GL_ARB_parallel_shader_compile")))
+    {
+        maxThreads = reinterpret_cast<SmlMaxShaderCompilerThreads>(ctx->getProcAddress("glMaxShaderCompilerThreadsARB"));
+    }
+
+    _parallel = nullptr != maxThreads;
+    if (maxThreads)
+    {
+        maxThreads(0xFFFFFFFF);
+    }
+}
+
+GLuint SmlGLProgramCompiler::CompileStage(QOpenGLFunctions_PROFILE* gl, GLenum stage, const GLchar* source)
+{
+    if (nullptr == source || 0 == source[0])
+    {
+        return 0;
+    }
+
+    GLuint shader = gl->glCreateShader(stage);
+    gl->glShaderSource(shader, 1, &source, NULL);
+    gl->glCompileShader(shader); //no status query here, that would wait for it
+    return shader;
+}
+
+void SmlGLProgramCompiler::LogErrors(QOpenGLFunctions_PROFILE* gl, GLuint object, const char* type)
+{
+    GLint success;
+    GLchar infoLog[1024];
+    if (0 == strcmp(type, "PROGRAM"))
+    {
+        gl->glGetProgramiv(object, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            gl->glGetProgramInfoLog(object, sizeof(infoLog), NULL, infoLog);
+            qDebug() << "ERROR::PROGRAM_LINKING_ERROR of type: " << type
+                << "\n" << infoLog
+                << "\n -- --------------------------------------------------- -- ";
+        }
+    }
+    else
+    {
+        gl->glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            gl->glGetShaderInfoLog(object, sizeof(infoLog), NULL, infoLog);
+            qDebug() << "ERROR::SHADER_COMPILATION_ERROR of type: " << type
+                << "\n" << infoLog
+                << "\n -- --------------------------------------------------- -- ";
+        }
+    }
+}
+
+SmlGLProgramTicket SmlGLProgramCompiler::Submit(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache,
+    const GLchar* vertSource, const GLchar* geomSource, const GLchar* fragSource)
+{
+    SML_TRACE_ZONE("SmlGLProgramCompiler::Submit");
+
+    if (!_opened)
+    {
+        Open();
+    }
+
+    SmlGLProgramTicket ticket;
+    if (_free.empty())
+    {
+        ticket.index = int(_entries.size());
+        _entries.emplace_back();
+    }
+    else
+    {
+        ticket.index = _free.back();
+        _free.pop_back();
+        quint32 generation = _entries[ticket.index].generation;
+        _entries[ticket.index] = Entry{};
+        _entries[ticket.index].generation = generation + 1;
+    }
+    Entry& entry = _entries[ticket.index];
+    ticket.generation = entry.generation;
+    entry.submitted.start();
+
+    if (cache && cache->Open(gl))
+    {
+        const GLchar* const sources[] = { vertSource, geomSource, fragSource };
+        QByteArray key = cache->Key(sources, 3);
+        GLuint cachedId = cache->Load(gl, key);
+        if (cachedId)
+        {
+            entry.programId = cachedId;
+            entry.program.Reflect(gl, cachedId);
+            entry.state = State::Ready;
+            cache->Record(true, entry.submitted.nsecsElapsed());
+            return ticket;
+        }
+        entry.cacheKey = key;
+    }
+
+    entry.shaders[0] = CompileStage(gl, GL_VERTEX_SHADER, vertSource);
+    entry.shaders[1] = CompileStage(gl, GL_GEOMETRY_SHADER, geomSource);
+    entry.shaders[2] = CompileStage(gl, GL_FRAGMENT_SHADER, fragSource);
+
+    entry.programId = gl->glCreateProgram();
+    for (GLuint shader : entry.shaders)
+    {
+        if (shader)
+        {
+            gl->glAttachShader(entry.programId, shader);
+        }
+    }
+    if (!entry.cacheKey.isEmpty())
+    {
+        gl->glProgramParameteri(entry.programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    gl->glLinkProgram(entry.programId);
+
+    ++_pending;
+    return ticket;
+}
+
+void SmlGLProgramCompiler::Finish(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache, Entry& entry)
+{
+    SML_TRACE_ZONE("SmlGLProgramCompiler::Finish");
+
+    //blocks on whatever the driver has not finished yet
+    static const char* const stageNames[] = { "VERTEX", "GEOMETRY", "FRAGMENT" };
+    for (int ii = 0; ii < 3; ++ii)
+    {
+        if (entry.shaders[ii])
+        {
+            LogErrors(gl, entry.shaders[ii], stageNames[ii]);
+        }
+    }
+    LogErrors(gl, entry.programId, "PROGRAM");
+
+    for (GLuint& shader : entry.shaders)
+    {
+        if (shader)
+        {
+            gl->glDeleteShader(shader); //flagged, freed with the program
+            shader = 0;
+        }
+    }
+
+    if (cache && !entry.cacheKey.isEmpty())
+    {
+        cache->Store(gl, entry.cacheKey, entry.programId);
+        cache->Record(false, entry.submitted.nsecsElapsed()); //submit to linked, frames in between included
+    }
+
+    entry.program.Reflect(gl, entry.programId);
+    entry.state = State::Ready;
+    --_pending;
+}
+
+void SmlGLProgramCompiler::Poll(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache)
+{
+    if (0 == _pending || !_parallel)
+    {
+        return; //without the extension the status query would block, Wait finishes them
+    }
+
+    for (Entry& entry : _entries)
+    {
+        if (0 == _pending)
+        {
+            break; //the rest are ready or taken
+        }
+        if (State::Linking != entry.state)
+        {
+            continue;
+        }
+
+        GLint done = GL_FALSE;
+        gl->glGetProgramiv(entry.programId, GL_COMPLETION_STATUS_KHR, &done);
+        if (done)
+        {
+            Finish(gl, cache, entry);
+        }
+    }
+}
+
+const SmlGLProgramCompiler::Entry* SmlGLProgramCompiler::Find(SmlGLProgramTicket ticket) const
+{
+    if (!ticket.IsValid() || ticket.index >= int(_entries.size()))
+    {
+        return nullptr;
+    }
+
+    const Entry& entry = _entries[ticket.index];
+    if (ticket.generation != entry.generation || State::Taken == entry.state)
+    {
+        return nullptr; //taken, maybe already handed to a newer ticket
+    }
+    return &entry;
+}
+
+bool SmlGLProgramCompiler::IsReady(SmlGLProgramTicket ticket) const
+{
+    const Entry* entry = Find(ticket);
+    return entry && State::Ready == entry->state;
+}
+
+SmlGLProgram SmlGLProgramCompiler::Wait(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache, SmlGLProgramTicket ticket)
+{
+    if (nullptr == Find(ticket))
+    {
+        qWarning() << "SmlGLProgramCompiler: ticket" << ticket.index << "is not pending";
+        return SmlGLProgram{};
+    }
+
+    Entry& entry = _entries[ticket.index];
+    if (State::Linking == entry.state)
+    {
+        Finish(gl, cache, entry);
+    }
+
+    entry.state = State::Taken;
+    SmlGLProgram program = entry.program;
+    entry.program = SmlGLProgram{};
+    entry.cacheKey.clear();
+    _free.push_back(ticket.index);
+    return program;
+}
+
+void SmlGLProgramCompiler::Reset(QOpenGLFunctions_PROFILE* gl)
+{
+    for (Entry& entry : _entries)
+    {
+        if (State::Taken == entry.state)
+        {
+            continue; //owned by whoever took it
+        }
+
+        for (GLuint shader : entry.shaders)
+        {
+            if (shader)
+            {
+                gl->glDeleteShader(shader);
+            }
+        }
+        gl->glDeleteProgram(entry.programId);
+    }
+
+    _entries.clear();
+    _free.clear();
+    _pending = 0;
+    _opened = false; //the next ctx may have other extensions
+    _parallel = false;
+}
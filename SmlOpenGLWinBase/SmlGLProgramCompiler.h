@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <vector>
+
+#include "SmlGLFunctions.h"
+#include "SmlGLProgram.h"
+
+class SmlGLProgramCache;
+
+//GL_KHR_parallel_shader_compile, same value in the ARB version
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+//slots are reused once taken, the generation tells a stale ticket from the slot's new owner
+struct SmlGLProgramTicket
+{
+    int index{ -1 };
+    quint32 generation{ 0 };
+
+    bool IsValid() const { return index >= 0; }
+};
+
+//compiles and links without asking the driver for the result, the status query is
+//what makes a driver finish the compile on the calling thread; with
+//GL_KHR_parallel_shader_compile (or the ARB one) the driver works on every submitted
+//program at once and Poll picks up the finished ones through GL_COMPLETION_STATUS_KHR
+//without blocking; without it nothing finishes in the background, Poll leaves every
+//program alone and Wait finishes each one where it is first used, so a program that
+//is never used never blocks
+//Wait blocks for a program that is needed now
+class SmlGLProgramCompiler final
+{
+private:
+    enum class State
+    {
+        Linking,
+        Ready,
+        Taken, //free, on _free for the next Submit
+    };
+
+    struct Entry
+    {
+        State state{ State::Linking };
+        quint32 generation{ 0 };
+        GLuint shaders[3]{};
+        GLuint programId{ 0 };
+        QByteArray cacheKey; //empty when the cache is off or this was a hit
+        QElapsedTimer submitted;
+        SmlGLProgram program;
+    };
+
+    bool _opened{ false };
+    bool _parallel{ false };
+    int _pending{ 0 };
+    std::vector<Entry> _entries; //indexed by SmlGLProgramTicket, as many as were ever in flight at once
+    std::vector<int> _free;      //taken slots
+
+private:
+    void Open();
+    static GLuint CompileStage(QOpenGLFunctions_PROFILE* gl, GLenum stage, const GLchar* source);
+    static void LogErrors(QOpenGLFunctions_PROFILE* gl, GLuint object, const char* type);
+    void Finish(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache, Entry& entry);
+    const Entry* Find(SmlGLProgramTicket ticket) const;
+
+public:
+    //render thread, ctx current; cache may be nullptr
+    SmlGLProgramTicket Submit(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache,
+        const GLchar* vertSource, const GLchar* geomSource, const GLchar* fragSource);
+    //once per frame, never blocks; does nothing without the extension
+    void Poll(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache);
+    bool IsReady(SmlGLProgramTicket ticket) const;
+    //blocks until linked, a ticket hands out its program once
+    SmlGLProgram Wait(QOpenGLFunctions_PROFILE* gl, SmlGLProgramCache* cache, SmlGLProgramTicket ticket);
+    //ctx about to go, deletes what was never taken
+    void Reset(QOpenGLFunctions_PROFILE* gl);
+
+    bool IsParallel() const { return _parallel; }
+    int Pending() const { return _pending; }
+};
@@ -0,0 +1,152 @@
+#include "SmlGLRenderService.h"
+#include "SmlGLWindow.h"
+#include "SmlTrace.h"
+
+#include <QMutexLocker>
+#include <QSurfaceFormat>
+#include <algorithm>
+
+
+void SmlGLRenderWorker::run()
+{
+    _clock.start();
+    while (!_quit.load())
+    {
+        ulong waitMs = RunPass();
+        _eventWake.Wait(waitMs);
+    }
+}
+
+ulong SmlGLRenderWorker::RunPass()
+{
+    const ulong SML_INFINITE = -1UL;
+    ulong waitMs = SML_INFINITE;
+
+    SML_TRACE_ZONE("SmlGLRenderWorker::RunPass");
+    {
+        //Add and Count on the ui thread never wait for a pass
+        QMutexLocker<QMutex> locker{ &_mutex };
+        for (SmlGLWindow* window : _added)
+        {
+            _windows.push_back(Entry{ window, 0 });
+        }
+        _added.clear();
+    }
+
+    const size_t count = _windows.size();
+    for (size_t ii = 0; ii < count; ++ii)
+    {
+        Entry& entry = _windows[(_next + ii) % count];
+        SmlGLWindow* window = entry.window;
+
+        qint64 now = _clock.nsecsElapsed();
+        bool due = now >= entry.nextDueNs;
+        bool pending = window->_ownerRenderPending.load();
+
+        if (!window->OwnerStep(due))
+        {
+            entry.window = nullptr;
+            _count.fetch_sub(1);
+            window->_eventOwnerReleased.Notify(false); //SmlGLRenderWorker::Remove
+            continue;
+        }
+
+        if (pending && due)
+        {
+            entry.nextDueNs = now + window->_serviceFrameIntervalNs.load();
+        }
+        else if (pending)
+        {
+            //over budget, come back when the window is due again
+            waitMs = std::min(waitMs, ulong((entry.nextDueNs - now) / 1000000) + 1);
+        }
+    }
+
+    _windows.erase(std::remove_if(_windows.begin(), _windows.end(),
+                                  [](const Entry& entry) { return nullptr == entry.window; }),
+                   _windows.end());
+
+    //rotate the first window of the next pass so no window is always served last
+    _next = _windows.empty() ? 0 : (_next + 1) % _windows.size();
+
+    return waitMs;
+}
+
+void SmlGLRenderWorker::Add(SmlGLWindow* window)
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    _added.push_back(window);
+    _count.fetch_add(1);
+}
+
+void SmlGLRenderWorker::Remove(SmlGLWindow* window)
+{
+    const ulong SML_INFINITE = -1UL;
+
+    window->_ownerQuit.store(true);
+    Wake();
+    window->_eventOwnerReleased.Wait(SML_INFINITE);
+}
+
+int SmlGLRenderWorker::Count()
+{
+    return _count.load();
+}
+
+void SmlGLRenderWorker::Wake()
+{
+    _eventWake.Notify(false);
+}
+
+void SmlGLRenderWorker::Stop()
+{
+    _quit.store(true);
+    Wake();
+    wait();
+}
+
+
+void SmlGLRenderService::Attach(SmlGLWindow* window)
+{
+    SmlGLRenderWorker* worker = *std::min_element(_workers.begin(), _workers.end(),
+        [](SmlGLRenderWorker* left, SmlGLRenderWorker* right) { return left->Count() < right->Count(); });
+
+    window->_serviceWorker = worker;
+    worker->Add(window);
+}
+
+void SmlGLRenderService::Detach(SmlGLWindow* window)
+{
+    if (window->_serviceWorker)
+    {
+        window->_serviceWorker->Remove(window);
+        window->_serviceWorker = nullptr;
+    }
+}
+
+SmlGLRenderService::SmlGLRenderService(QObject* parent, int threadCount /*= 1*/) :
+    QObject{ parent }
+{
+    _shareCtx = new QOpenGLContext{ this }; //never made current, only roots the share group
+    _shareCtx->setFormat(QSurfaceFormat::defaultFormat());
+    _shareCtx->create();
+
+    threadCount = std::max(threadCount, 1);
+    for (int ii = 0; ii < threadCount; ++ii)
+    {
+        auto* worker = new SmlGLRenderWorker{};
+        worker->setObjectName(QString{ "SmlGLRenderService worker %1" }.arg(ii));
+        worker->start();
+        _workers.push_back(worker);
+    }
+}
+
+SmlGLRenderService::~SmlGLRenderService()
+{
+    for (SmlGLRenderWorker* worker : _workers)
+    {
+        worker->Stop();
+        delete worker;
+    }
+    _workers.clear();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QOpenGLContext>
+
+#include <atomic>
+#include <vector>
+
+#include "SmlWaitObject.h"
+
+class SmlGLWindow;
+
+//one service thread of SmlGLRenderService, renders its windows round robin, one frame per window per pass
+class SmlGLRenderWorker final : public QThread
+{
+private:
+    struct Entry
+    {
+        SmlGLWindow* window{ nullptr };
+        qint64 nextDueNs{ 0 };
+    };
+
+    QMutex _mutex; //guards _added only, a pass renders without it
+    std::vector<SmlGLWindow*> _added; //taken over by the next pass
+    std::atomic<int> _count{ 0 };
+
+    std::vector<Entry> _windows; //worker thread only
+    size_t _next{ 0 };
+
+    std::atomic<bool> _quit{ false };
+    SmlEvent _eventWake{ true };
+    QElapsedTimer _clock;
+
+private:
+    virtual void run() override;
+    ulong RunPass();
+
+public:
+    void Add(SmlGLWindow* window);
+    void Remove(SmlGLWindow* window);
+    int Count();
+    void Wake();
+    void Stop();
+};
+
+
+//drives many ctx owner mode windows from a fixed number of threads,
+//windows are spread over the threads and must be destroyed before the service
+class SmlGLRenderService final : public QObject
+{
+    Q_OBJECT
+
+private:
+    QOpenGLContext* _shareCtx{ nullptr };
+    std::vector<SmlGLRenderWorker*> _workers;
+
+private:
+    friend class SmlGLWindow;
+
+    void Attach(SmlGLWindow* window);
+    void Detach(SmlGLWindow* window);
+
+public:
+    //all windows' contexts share their objects with this one
+    QOpenGLContext* ShareContext() const { return _shareCtx; }
+    int ThreadCount() const { return int(_workers.size()); }
+
+public:
+    SmlGLRenderService(QObject* parent, int threadCount = 1);
+    virtual ~SmlGLRenderService() override;
+};
@@ -0,0 +1,173 @@
+#include "SmlGLResourceLoader.h"
+
+#include <QMutexLocker>
+#include <QDebug>
+
+#include "SmlTrace.h"
+
+
+SmlGLResourceLoader::SmlGLResourceLoader(const QSurfaceFormat& format)
+{
+    _surface = new QOffscreenSurface{};
+    _surface->setFormat(format);
+    _surface->create();
+
+    setObjectName("SmlGLResourceLoader");
+}
+
+SmlGLResourceLoader::~SmlGLResourceLoader()
+{
+    Stop();
+
+    delete _surface;
+    _surface = nullptr;
+}
+
+void SmlGLResourceLoader::Start(QOpenGLContext* shareCtx)
+{
+    if (!isRunning())
+    {
+        _shareCtx = shareCtx;
+        _quit.store(false);
+        _failed.store(false);
+        start();
+    }
+}
+
+void SmlGLResourceLoader::Stop()
+{
+    if (isRunning())
+    {
+        _quit.store(true);
+        _eventWake.Notify(false);
+        wait();
+    }
+}
+
+void SmlGLResourceLoader::Enqueue(UploadFunc upload, ReadyFunc ready)
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    _tasks.push_back(Task{ std::move(upload), std::move(ready) });
+    locker.unlock();
+
+    _eventWake.Notify(false); //SmlGLResourceLoader::run
+}
+
+void SmlGLResourceLoader::run()
+{
+    const ulong SML_INFINITE = -1UL;
+
+    _ctx = new QOpenGLContext{ nullptr };
+    _ctx->setFormat(_surface->format());
+    _ctx->setShareContext(_shareCtx);
+    bool ok = _ctx->create() && _ctx->makeCurrent(_surface);
+    if (!ok)
+    {
+        //no ctx sharing here; what was queued keeps its placeholder
+        qWarning() << "SmlGLResourceLoader: can not create a shared ctx, uploads are dropped";
+        delete _ctx;
+        _ctx = nullptr;
+
+        QMutexLocker<QMutex> locker{ &_mutex };
+        _tasks.clear();
+        _failed.store(true);
+        return;
+    }
+
+    QOpenGLFunctions_PROFILE gl;
+    gl.initializeOpenGLFunctions();
+
+    while (!_quit.load())
+    {
+        QMutexLocker<QMutex> locker{ &_mutex };
+        if (_tasks.empty())
+        {
+            locker.unlock();
+            _eventWake.Wait(SML_INFINITE);
+            continue;
+        }
+
+        Task task = std::move(_tasks.front());
+        _tasks.pop_front();
+        locker.unlock();
+
+        {
+            SML_TRACE_ZONE("SmlGLResourceLoader upload");
+            task.upload(&gl);
+        }
+
+        GLsync fence = gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        gl.glFlush(); //the fence must reach the gpu before another ctx waits on it
+
+        locker.relock();
+        _done.push_back(Done{ fence, std::move(task.ready) });
+    }
+
+    _ctx->doneCurrent();
+    delete _ctx;
+    _ctx = nullptr;
+}
+
+void SmlGLResourceLoader::PollReady(QOpenGLFunctions_PROFILE* gl)
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    if (_done.empty())
+    {
+        return;
+    }
+
+    std::vector<Done> ready;
+    for (auto it = _done.begin(); it != _done.end(); )
+    {
+        GLenum status = gl->glClientWaitSync(it->fence, 0, 0); //poll only
+        if (GL_ALREADY_SIGNALED == status || GL_CONDITION_SATISFIED == status)
+        {
+            ready.push_back(std::move(*it));
+            it = _done.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    locker.unlock();
+
+    for (Done& done : ready)
+    {
+        gl->glDeleteSync(done.fence);
+        if (done.ready)
+        {
+            done.ready();
+        }
+    }
+}
+
+void SmlGLResourceLoader::HandOverAll(QOpenGLFunctions_PROFILE* gl)
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    _tasks.clear(); //never uploaded, nothing to free
+    std::vector<Done> ready = std::move(_done);
+    _done.clear();
+    locker.unlock();
+
+    //no wait on the fences: deleting an object the gpu still writes is deferred by the driver
+    for (Done& done : ready)
+    {
+        gl->glDeleteSync(done.fence);
+        if (done.ready)
+        {
+            done.ready();
+        }
+    }
+}
+
+void SmlGLResourceLoader::Discard(QOpenGLFunctions_PROFILE* gl)
+{
+    QMutexLocker<QMutex> locker{ &_mutex };
+    _tasks.clear();
+    for (Done& done : _done)
+    {
+        gl->glDeleteSync(done.fence);
+    }
+    _done.clear();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QSurfaceFormat>
+
+#include <functional>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include "SmlWaitObject.h"
+
+#include "SmlGLFunctions.h"
+
+//uploads buffers and textures on its own thread with a ctx in the window's share group
+//a finished upload is fenced and handed to the render thread once the fence signals
+class SmlGLResourceLoader final : public QThread
+{
+public:
+    using UploadFunc = std::function<void(QOpenGLFunctions_PROFILE* gl)>; //loader thread, loader ctx current
+    using ReadyFunc = std::function<void()>;                               //render thread, render ctx current
+
+private:
+    struct Task
+    {
+        UploadFunc upload;
+        ReadyFunc ready;
+    };
+
+    struct Done
+    {
+        GLsync fence{ nullptr };
+        ReadyFunc ready;
+    };
+
+    QOffscreenSurface* _surface{ nullptr }; //created on the ui thread
+    QOpenGLContext* _shareCtx{ nullptr };
+    QOpenGLContext* _ctx{ nullptr };        //created on the loader thread
+
+    QMutex _mutex;
+    std::deque<Task> _tasks;
+    std::vector<Done> _done;
+
+    std::atomic<bool> _quit{ false };
+    std::atomic<bool> _failed{ false }; //no shared ctx on this platform, the thread has ended
+    SmlEvent _eventWake{ true };
+
+private:
+    virtual void run() override;
+
+public:
+    //ui thread, QOffscreenSurface has to be created there
+    SmlGLResourceLoader(const QSurfaceFormat& format);
+    virtual ~SmlGLResourceLoader() override;
+
+    //starts the thread once the render ctx exists
+    void Start(QOpenGLContext* shareCtx);
+    void Stop();
+
+    //any thread
+    void Enqueue(UploadFunc upload, ReadyFunc ready);
+    //the loader ctx could not be created or made current, queued uploads were dropped
+    bool IsFailed() const { return _failed.load(); }
+
+    //render thread, never blocks: runs ready for every upload the gpu has finished
+    void PollReady(QOpenGLFunctions_PROFILE* gl);
+    //render thread, loader stopped, before GLFinalize: runs ready for every finished upload
+    //whether or not the gpu is done, so GLFinalize frees what they created
+    void HandOverAll(QOpenGLFunctions_PROFILE* gl);
+    //render thread, drops uploads that were never handed over, when ready can no longer run
+    void Discard(QOpenGLFunctions_PROFILE* gl);
+};
@@ -1,7 +1,17 @@
 #include <QtGlobal>
 
 #include "SmlGLWindow.h"
+#include "SmlGLRenderService.h"
+#include "SmlTrace.h"
+#include "SmlAllocTracker.h"
+#include "SmlPerfCounters.h"
 #include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QScreen>
+#include <QGuiApplication>
+#include <QDebug>
+
+#include <algorithm>
 
 
 SmlThreadGLRender::SmlThreadGLRender(QObject* parent, SmlGLWindow* window) :
@@ -15,9 +25,16 @@ void SmlThreadGLRender::Render()
     _glwin->ThreadRender();
 }
 
+void SmlThreadGLRender::OwnerLoop()
+{
+    _glwin->OwnerLoop();
+}
+
 
 void SmlGLWindow::RequestRender()
 {
+    SML_TRACE_ZONE("SmlGLWindow::RequestRender");
+
     if (!_multiThreadMode)
     {
         Render();
@@ -32,6 +49,14 @@ void SmlGLWindow::RequestRender()
     }
 
 
+    if (_ctxOwnerMode)
+    {
+        _ownerRenderPending.store(true);
+        OwnerPost(); //no ctx hop, no semaphore
+        return;
+    }
+
+
     if (_requestMode)
     {
         emit RequestRenderSignal(); //SmlThreadGLRender::Render
@@ -44,9 +69,14 @@ void SmlGLWindow::RequestRender()
     }
 
     const ulong timeOut = 500;
-    bool waitOK = _ctxSemphore.Wait(timeOut);
+    bool waitOK = false;
+    {
+        SML_TRACE_ZONE("wait _ctxSemphore");
+        waitOK = _ctxSemphore.Wait(timeOut);
+    }
     if (!waitOK)
     {
+        _pacer.FrameDropped();
         return;
     }
 
@@ -76,6 +106,8 @@ static void xxxDelay()
 
 void SmlGLWindow::ThreadRender()
 {
+    SML_TRACE_ZONE("SmlGLWindow::ThreadRender");
+
     bool ctxResponsedOk = true;
     if (_requestMode)
     {
@@ -103,17 +135,224 @@ void SmlGLWindow::ThreadRender()
 
 void SmlGLWindow::Render()
 {
-    if (isExposed())
+    SML_TRACE_ZONE("SmlGLWindow::Render");
+
+    if (IsHeadless() || isExposed())
     {
+        //once warmed up a frame must not allocate outside the exempt phases
+        SML_ALLOC_FRAME("SmlGLWindow::Render", _frameIndex);
+        SML_ALLOC_PHASE("SmlGLWindow::Render");
 
-        MakeCurrentCtx(__FUNCTION__, __FILE__);
+        {
+            SML_ALLOC_PHASE_EXEMPT("makeCurrent"); //platform code
+            MakeCurrentCtx(__FUNCTION__, __FILE__);
+        }
+        if (_fbo)
+        {
+            _fbo->bind(); //GLPaint draws into the fbo as if it was the default framebuffer
+        }
 
-        GLPaint(_paintDev);
-        _glctx->swapBuffers(this);
+        {
+            //only does work when something happened: resize, commands, uploads, toggles
+            SML_ALLOC_PHASE_EXEMPT("frame events");
+            ApplyPendingResize();
+            DrainCommands();
+            if (_loader)
+            {
+                _loader->PollReady(this);
+            }
+            _programCompiler.Poll(this, _programCache);
+
+            if (_profiling.load() != _profiler.IsCreated())
+            {
+                _profiling.load() ? _profiler.Create(this) : _profiler.Destroy();
+            }
+            SetGLInstrumented(_glInstrumenting.load());
+        }
+        GLFrameBegin();
 
-        DoneCurrentCtx();
+        _pacer.FrameBegin();
+        _frameStats.FrameBegin(this);
+        BeginFrameSlot();
+        if (_uniformRing.IsCreated())
+        {
+            _uniformRing.BeginFrame(_frameSlot); //BeginFrameSlot waited for the gpu to leave it
+        }
+        _profiler.BeginFrame();
+
+        {
+            SmlGLProfileScope frameScope{ _profiler, "frame" };
+            {
+                SmlGLProfileScope paintScope{ _profiler, "paint" };
+                SML_ALLOC_PHASE("GLPaint");
+                SML_PERF_SCOPE("GLPaint"); //cpu side of the submission
+                GLPaint(_paintDev);
+            }
+            _frameStats.GpuEnd();
+            if (!IsHeadless())
+            {
+                SmlGLProfileScope swapScope{ _profiler, "swap" };
+                SML_TRACE_ZONE("swapBuffers");
+                SML_ALLOC_PHASE_EXEMPT("swapBuffers"); //platform and driver code
+                _glctx->swapBuffers(this);
+            }
+        }
+
+        if (_fbo && _grabPending.exchange(false))
+        {
+            SML_ALLOC_PHASE_EXEMPT("grab");
+            _grabbedFrame = _fbo->toImage();
+        }
+
+        _profiler.EndFrame();
+        GLFrameEnd();
+        EndFrameSlot();
+        _frameStats.FrameEnd();
+        _pacer.FrameEnd();
+
+        {
+            SML_ALLOC_PHASE_EXEMPT("doneCurrent");
+            DoneCurrentCtx();
+        }
+
+        if (IsHeadless())
+        {
+            _eventHeadlessFrameDone.Notify(false); //SmlGLWindow::RenderHeadlessFrame
+        }
+    }
+}
+
+bool SmlGLWindow::PostCommand(const SmlRenderCommand& cmd)
+{
+    bool ok = _commands.TryPush(cmd);
+    requestUpdate(); //make sure a frame comes to drain it
+    return ok;
+}
+
+void SmlGLWindow::EnableResourceLoader()
+{
+    if (nullptr == _loader)
+    {
+        _loader = new SmlGLResourceLoader{ requestedFormat() };
+    }
+}
 
+void SmlGLWindow::EnableProgramCache(const QString& dir)
+{
+    if (_programCache || qEnvironmentVariable("SML_PROGRAM_CACHE") == "0")
+    {
+        return;
+    }
+    _programCache = new SmlGLProgramCache{ dir };
+}
+
+SmlGLProgramCacheStats SmlGLWindow::GetProgramCacheStats() const
+{
+    return _programCache ? _programCache->Stats() : SmlGLProgramCacheStats{};
+}
+
+void SmlGLWindow::EnableWaitStats()
+{
+    if (_ctxSemphoreStats)
+    {
+        return;
+    }
+
+    QByteArray className = metaObject()->className();
+    _ctxSemphoreStats = new SmlWaitStats{ className + "::_ctxSemphore" };
+    _eventCtxResponsedStats = new SmlWaitStats{ className + "::_eventCtxResponsed" };
+    _eventOwnerWakeStats = new SmlWaitStats{ className + "::_eventOwnerWake" };
+
+    _ctxSemphore.SetStats(_ctxSemphoreStats);
+    _eventCtxResponsed.SetStats(_eventCtxResponsedStats);
+    _eventOwnerWake.SetStats(_eventOwnerWakeStats);
+}
+
+bool SmlGLWindow::UploadAsync(SmlGLResourceLoader::UploadFunc upload, SmlGLResourceLoader::ReadyFunc ready)
+{
+    if (nullptr == _loader || _loader->IsFailed())
+    {
+        return false;
+    }
+
+    _loader->Enqueue(std::move(upload), std::move(ready));
+    return true;
+}
+
+void SmlGLWindow::DrainCommands()
+{
+    _commands.Drain([this](const SmlRenderCommand& cmd)
+    {
+        GLCommand(cmd);
+    });
+}
+
+void SmlGLWindow::WaitFrameFence(int slot)
+{
+    GLsync& fence = _frameFences[slot];
+    if (fence)
+    {
+        //a timeout means the gpu still reads the slot, its resources (uniform ring region too)
+        //must not be touched before the fence has signaled
+        const GLuint64 timeOutNs = 500ull * 1000 * 1000;
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        GLenum waitResult = glClientWaitSync(fence, flags, timeOutNs);
+        while (GL_TIMEOUT_EXPIRED == waitResult)
+        {
+            {
+                SML_ALLOC_PHASE_EXEMPT("frame fence stall");
+                qWarning() << "SmlGLWindow: frame slot" << slot << "still in flight after" << timeOutNs / 1000000 << "ms";
+            }
+            flags = 0; //flushed by the first wait
+            waitResult = glClientWaitSync(fence, flags, timeOutNs);
+        }
+
+        Q_ASSERT_X(GL_WAIT_FAILED != waitResult, __FUNCTION__, __FILE__);
+        if (GL_WAIT_FAILED == waitResult)
+        {
+            glFinish(); //the fence can not be waited on, make sure the gpu is done before the slot is reused
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+void SmlGLWindow::BeginFrameSlot()
+{
+    int count = _framesInFlight.load();
+    if (count != _framesInFlightApplied)
+    {
+        //depth changed, drain the pipeline before re-slicing the slots
+        for (int ii = 0; ii < SML_MAX_FRAMES_IN_FLIGHT; ++ii)
+        {
+            WaitFrameFence(ii);
+        }
+        _framesInFlightApplied = count;
+        _frameIndex = 0;
+    }
+
+    _frameSlot = int(_frameIndex % _framesInFlightApplied);
+    WaitFrameFence(_frameSlot); //gpu is done with the resources of this slot
+}
+
+void SmlGLWindow::EndFrameSlot()
+{
+    _frameFences[_frameSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++_frameIndex;
+}
+
+void SmlGLWindow::ReleaseFrameFences()
+{
+    for (GLsync& fence : _frameFences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
     }
+    _framesInFlightApplied = 0;
 }
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
@@ -135,20 +374,20 @@ static void APIENTRY GLDebugPoc(
         GLsizei length, const GLchar* message,
         const void* userParam)
 {
-    QString str = QString::fromUtf16(
-                u"severity:%3 message:[%5] source:%0 type:%1 id:%2 length:%4")
-            .arg(source)
-            .arg(type)
-            .arg(id)
-            .arg(severity)
-            .arg(length)
-            .arg(message);
-
-    qDebug() << str;
+    //may run inside a frame, streamed once instead of a QString per .arg()
+    SML_ALLOC_PHASE_EXEMPT("GLDebugPoc");
+    qDebug().nospace() << "severity:" << severity
+        << " message:[" << message
+        << "] source:" << source
+        << " type:" << type
+        << " id:" << id
+        << " length:" << length;
 }
 
 void SmlGLWindow::resizeEvent(QResizeEvent* ev)
 {
+    SML_TRACE_ZONE("SmlGLWindow::resizeEvent");
+
     if (_SurfaceDestroyed)
     {
         return;
@@ -156,43 +395,120 @@ void SmlGLWindow::resizeEvent(QResizeEvent* ev)
 
     SML_QTBase::resizeEvent(ev);
 
-    bool initGL = false;
+    if (IsHeadless())
+    {
+        return; //sized by ResizeHeadless only
+    }
+
+    ApplyResize(ev->size(), devicePixelRatio());
+}
+
+void SmlGLWindow::ApplyResize(const QSize& size, qreal dpr)
+{
+    if (_ctxOwnerMode)
+    {
+        _resizeState.Publish(SmlResizeRequest{ size, dpr });
+        _ownerRenderPending.store(true); //applied at the start of the next frame
+        OwnerPost(); //SmlGLWindow::OwnerLoop
+        return;
+    }
+
+    //the first resize creates the ctx and initializes gl, later ones never wait for the render thread
+    if (_multiThreadMode && _coalescedResize.load() && _glctx)
+    {
+        _resizeState.Publish(SmlResizeRequest{ size, dpr });
+        if (!IsHeadless())
+        {
+            requestUpdate();
+        }
+        return;
+    }
 
     const ulong SML_INFINITE = -1UL;
-    bool waitOk = _ctxSemphore.Wait(SML_INFINITE);
+    bool waitOk = false;
+    {
+        SML_TRACE_ZONE("wait _ctxSemphore");
+        waitOk = _ctxSemphore.Wait(SML_INFINITE);
+    }
     if(waitOk)
     {
-        if (nullptr == _glctx)
+        //a size published while coalescing was on is older than this one, the next Render
+        //would apply it over this; the render thread is out of Render while we hold the ctx
+        if (_resizeState.HasNew())
         {
-            initGL = true;
-            _glctx = new QOpenGLContext{ nullptr }; //cannot have parent for moving thread
-            _glctx->setFormat(requestedFormat());
-            _glctx->setShareContext(nullptr);
-            _glctx->create();
+            _resizeState.Read();
         }
+        ResizeGL(size, dpr);
 
-        MakeCurrentCtx(__FUNCTION__, __FILE__);
+        _ctxSemphore.Notify(false); //ok to move opengl context
+    }
+}
 
-        if (initGL)
-        {
-            _paintDev = new QOpenGLPaintDevice{};
+void SmlGLWindow::ResizeGL(const QSize& size, qreal dpr)
+{
+    bool initGL = false;
 
-            initializeOpenGLFunctions();
-            glDebugMessageCallback(GLDebugPoc, nullptr);
+    if (nullptr == _glctx)
+    {
+        initGL = true;
+        QSurfaceFormat format = requestedFormat();
+        int swapInterval = _swapInterval.load();
+        if (swapInterval >= 0)
+        {
+            format.setSwapInterval(swapInterval);
+        }
 
+        _glctx = new QOpenGLContext{ nullptr }; //cannot have parent for moving thread
+        _glctx->setFormat(format);
+        _glctx->setShareContext(_service ? _service->ShareContext() : nullptr);
+        _glctx->create();
 
-            GLInitialize();
+        if (_loader)
+        {
+            _loader->Start(_glctx); //before GLInitialize, so it can queue uploads
         }
+    }
 
-        qreal dpr = devicePixelRatio();
-        _paintDev->setDevicePixelRatio(dpr);
-        _paintDev->setSize(ev->size() * dpr);
+    MakeCurrentCtx(__FUNCTION__, __FILE__);
 
-        GLResize(ev->size(), ev->oldSize());
+    if (initGL)
+    {
+        _paintDev = new QOpenGLPaintDevice{};
 
-        DoneCurrentCtx();
+        initializeOpenGLFunctions();
+        glDebugMessageCallback(GLDebugPoc, nullptr);
 
-        _ctxSemphore.Notify(false); //ok to move opengl context
+
+        GLInitialize();
+    }
+
+    ResizeGLCurrent(size, dpr);
+
+    DoneCurrentCtx();
+}
+
+void SmlGLWindow::ResizeGLCurrent(const QSize& size, qreal dpr)
+{
+    if (IsHeadless())
+    {
+        delete _fbo;
+        _fbo = new QOpenGLFramebufferObject{ size * dpr, QOpenGLFramebufferObject::CombinedDepthStencil };
+        _fbo->bind();
+    }
+
+    _paintDev->setDevicePixelRatio(dpr);
+    _paintDev->setSize(size * dpr);
+
+    GLResize(size, _appliedSize);
+    _appliedSize = size;
+}
+
+void SmlGLWindow::ApplyPendingResize()
+{
+    if (_resizeState.HasNew())
+    {
+        const SmlResizeRequest& request = _resizeState.Read(); //latest only, older sizes are dropped
+        ResizeGLCurrent(request.size, request.dpr);
     }
 }
 
@@ -239,35 +555,171 @@ bool SmlGLWindow::event(QEvent* ev)
 void SmlGLWindow::FinalizeGL()
 {
     const ulong SML_INFINITE = -1UL;
+
+    if (_ctxOwnerMode)
+    {
+        _ownerFinalizePending.store(true);
+        OwnerPost(); //SmlGLWindow::OwnerLoop
+        _eventOwnerFinalized.Wait(SML_INFINITE); //the surface must outlive GLFinalize
+        return;
+    }
+
     bool waitOk = _ctxSemphore.Wait(SML_INFINITE);
     if(waitOk)
     {
-        if (_glctx)
-        {
-            MakeCurrentCtx(__FUNCTION__, __FILE__);
+        FinalizeGLCurrent();
 
+        _ctxSemphore.Notify(false);
+    }
+}
+
+void SmlGLWindow::FinalizeGLCurrent(bool derivedAlive)
+{
+    if (_glctx)
+    {
+        MakeCurrentCtx(__FUNCTION__, __FILE__);
+
+        ReleaseFrameFences();
+        _profiler.Destroy();
+        _frameStats.Destroy();
+        if (_loader)
+        {
+            _loader->Stop();
+            if (derivedAlive)
+            {
+                _loader->HandOverAll(this); //uploads GLPaint never saw are freed by GLFinalize
+            }
+            else
+            {
+                _loader->Discard(this);
+            }
+        }
+        if (derivedAlive)
+        {
             GLFinalize();
+        }
+        ReleaseShaderVariants();
+        _programCompiler.Reset(this);
+        _uniformRing.Destroy();
+        ResetGLState(); //names are reused by the next ctx
 
-            delete _paintDev;
-            _paintDev = nullptr;
+        delete _paintDev;
+        _paintDev = nullptr;
+        delete _fbo;
+        _fbo = nullptr;
 
-            DoneCurrentCtx();
+        DoneCurrentCtx();
+    }
+}
+
+void SmlGLWindow::OwnerPost()
+{
+    if (_serviceWorker)
+    {
+        _serviceWorker->Wake(); //SmlGLRenderWorker::RunPass
+        return;
+    }
+
+    _eventOwnerWake.Notify(false);
+}
+
+void SmlGLWindow::OwnerLoop()
+{
+    const ulong SML_INFINITE = -1UL;
+
+    bool alive = true;
+    while (alive)
+    {
+        {
+            SML_TRACE_ZONE("wait _eventOwnerWake");
+            _eventOwnerWake.Wait(SML_INFINITE);
         }
+        alive = OwnerStep(true);
+    }
+}
 
-        _ctxSemphore.Notify(false);
+bool SmlGLWindow::OwnerStep(bool renderAllowed)
+{
+    if (_ownerQuit.load())
+    {
+        OwnerRelease();
+        return false;
+    }
+
+    /////////////////////////////////////////////////////////////////
+    if (_ownerFinalizePending.exchange(false))
+    {
+        if (!_ownerFinalized)
+        {
+            FinalizeGLCurrent();
+            if (_glctx)
+            {
+                _glctx->doneCurrent();
+                delete _glctx; //owned by this thread
+                _glctx = nullptr;
+            }
+            _ownerFinalized = true;
+        }
+
+        _eventOwnerFinalized.Notify(false);
+        return true;
+    }
+
+    if (_ownerFinalized)
+    {
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////
+    if (nullptr == _glctx && _resizeState.HasNew())
+    {
+        const SmlResizeRequest& request = _resizeState.Read();
+        ResizeGL(request.size, request.dpr); //creates the ctx and calls GLInitialize
+    }
+
+    /////////////////////////////////////////////////////////////////
+    if (renderAllowed && _ownerRenderPending.exchange(false) && _glctx)
+    {
+        Render();
+
+        emit RenderFrameDoneSignal(); //SmlThreadGLWindow::requestUpdate
+    }
+
+    return true;
+}
+
+void SmlGLWindow::OwnerRelease()
+{
+    //window destroyed without a surface event: the derived part is gone and GLFinalize with it,
+    //everything the base created is still freed on its own ctx
+    if (_glctx)
+    {
+        FinalizeGLCurrent(false);
+        _glctx->doneCurrent();
+        delete _glctx;
+        _glctx = nullptr;
     }
 }
 
+QSurface* SmlGLWindow::Surface()
+{
+    if (_offscreen)
+    {
+        return _offscreen;
+    }
+    return this;
+}
+
 bool SmlGLWindow::MakeCurrentCtx(const char* msg, const char* msg1)
 {
-    bool ok = _glctx->makeCurrent(this);
+    bool ok = _glctx->makeCurrent(Surface());
     Q_ASSERT_X(ok && _glctx->isValid(), msg, msg1);
     return ok;
 }
 
 void SmlGLWindow::DoneCurrentCtx()
 {
-    if (_multiThreadMode) //required for multi threaded mode rendering
+    if (_multiThreadMode && !_ctxOwnerMode) //required for multi threaded mode rendering
     {
         _glctx->doneCurrent();
     }
@@ -284,109 +736,179 @@ void SmlGLWindow::RequestCtx()
     }
 
     const ulong SML_INFINITE = -1UL;
+    SML_TRACE_ZONE("wait _eventCtxResponsed");
     _eventCtxResponsed.Wait(SML_INFINITE);
 }
 
-inline void SmlGLWindow::checkCompileErrors(GLuint shader, const char* type)
+SmlGLProgram SmlGLWindow::CreateProgram(const GLchar* const vertSource, const GLchar* const geomSource, const GLchar* const fragSource)
 {
-    GLint success;
-    GLchar infoLog[1024];
-    if (0 == stricmp(type, "PROGRAM"))
+    return WaitProgram(CreateProgramAsync(vertSource, geomSource, fragSource));
+}
+
+SmlGLProgramTicket SmlGLWindow::CreateProgramAsync(const GLchar* const vertSource, const GLchar* const geomSource, const GLchar* const fragSource)
+{
+    return _programCompiler.Submit(this, _programCache, vertSource, geomSource, fragSource);
+}
+
+bool SmlGLWindow::IsProgramReady(SmlGLProgramTicket ticket) const
+{
+    return _programCompiler.IsReady(ticket);
+}
+
+SmlGLProgram SmlGLWindow::WaitProgram(SmlGLProgramTicket ticket)
+{
+    return _programCompiler.Wait(this, _programCache, ticket);
+}
+
+void SmlGLWindow::BindUniformBlock(const SmlGLUniformBlock& block, const SmlUniformAlloc& alloc)
+{
+    if (block.IsValid() && alloc.IsValid())
     {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success)
-        {
-            glGetProgramInfoLog(shader, _countof(infoLog), NULL, infoLog);
-            qDebug() << "ERROR::PROGRAM_LINKING_ERROR of type: " << type
-                << "\n" << infoLog
-                << "\n -- --------------------------------------------------- -- ";
-        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, block.binding, alloc.buffer, alloc.offset, alloc.size);
     }
-    else
+}
+
+void SmlGLWindow::SetVertexAttribute(GLuint vao, const SmlGLAttribute& attribute, GLint size, GLenum type,
+    GLuint buffer, GLsizei stride, GLuint divisor)
+{
+    if (!attribute.IsValid())
     {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success)
-        {
-            glGetShaderInfoLog(shader, _countof(infoLog), NULL, infoLog);
-            qDebug() << "ERROR::SHADER_COMPILATION_ERROR of type: " << type
-                << "\n" << infoLog
-                << "\n -- --------------------------------------------------- -- ";
-        }
+        return;
     }
+
+    glVertexArrayAttribBinding(vao, attribute.location, attribute.location);
+    glVertexArrayAttribFormat(vao, attribute.location, size, type, GL_FALSE, 0);
+    glVertexArrayVertexBuffer(vao, attribute.location, buffer, 0, stride);
+    if (divisor)
+    {
+        glVertexArrayBindingDivisor(vao, attribute.location, divisor);
+    }
+    glEnableVertexArrayAttrib(vao, attribute.location);
 }
 
-GLuint SmlGLWindow::CreateProgram(const GLchar* const vertSource, const GLchar* const geomSource, const GLchar* const fragSource)
+SmlGLProgramTicket SmlGLWindow::SubmitShaderVariant(const ShaderVariant& variant)
 {
-    /////////////////////////////////////////////////////////////////
-    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertShader, 1, &vertSource, NULL); // vertex_shader_source is a GLchar* containing glsl shader source code
-    glCompileShader(vertShader);
-    checkCompileErrors(vertShader, "VERTEX");
-
-    ///////////////////////////////////////////////////////////////
-    GLuint geomShader = 0;
-    if (geomSource && geomSource[0])
+    //a stage that fails to expand compiles empty, the link error shows up in the log
+    QByteArray sources[3];
+    const QString* paths[3] = { &variant.files.vert, &variant.files.geom, &variant.files.frag };
+    for (int ii = 0; ii < 3; ++ii)
     {
-        geomShader = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(geomShader, 1, &geomSource, NULL); // vertex_shader_source is a GLchar* containing glsl shader source code
-        glCompileShader(geomShader);
-        checkCompileErrors(geomShader, "GEOMETRY");
+        SmlShaderPreprocessor preprocessor;
+        if (!paths[ii]->isEmpty() && preprocessor.Expand(*paths[ii], variant.defines))
+        {
+            sources[ii] = preprocessor.Source();
+        }
     }
 
-    /////////////////////////////////////////////////////////////////
-    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragShader, 1, &fragSource, NULL); // vertex_shader_source is a GLchar* containing glsl shader source code
-    glCompileShader(fragShader);
-    checkCompileErrors(fragShader, "FRAGMENT");
+    return CreateProgramAsync(sources[0].constData(), sources[1].constData(), sources[2].constData());
+}
 
-    /////////////////////////////////////////////////////////////////
-    GLuint programId = glCreateProgram();
+SmlShaderVariant SmlGLWindow::RequestProgramVariant(const SmlShaderFiles& files, const QByteArrayList& defines)
+{
+    QByteArrayList sorted = defines;
+    std::sort(sorted.begin(), sorted.end());
+    QByteArray key = files.vert.toUtf8() + '\n' + files.geom.toUtf8() + '\n' + files.frag.toUtf8() + '\n' + sorted.join(' ');
 
-    if (vertShader)
+    SmlShaderVariant variant;
+    for (size_t ii = 0; ii < _shaderVariants.size(); ++ii)
     {
-        glAttachShader(programId, vertShader);
+        if (_shaderVariants[ii].key == key)
+        {
+            variant.index = int(ii);
+            return variant;
+        }
     }
 
-    if (geomShader)
-    {
-        glAttachShader(programId, geomShader);
-    }
+    ShaderVariant entry;
+    entry.files = files;
+    entry.defines = sorted;
+    entry.key = key;
+    entry.pending = SubmitShaderVariant(entry);
+    variant.index = int(_shaderVariants.size());
+    _shaderVariants.push_back(std::move(entry));
+    return variant;
+}
 
-    if (fragShader)
+bool SmlGLWindow::IsProgramVariantReady(SmlShaderVariant variant) const
+{
+    if (!variant.IsValid() || variant.index >= int(_shaderVariants.size()))
     {
-        glAttachShader(programId, fragShader);
+        return false;
     }
-    
 
-    glLinkProgram(programId);
-    checkCompileErrors(programId, "PROGRAM");
+    const ShaderVariant& entry = _shaderVariants[variant.index];
+    return entry.program.Id() || IsProgramReady(entry.pending);
+}
 
-    /////////////////////////////////////////////////////////////////
-    if (vertShader)
+const SmlGLProgram& SmlGLWindow::ProgramVariant(SmlShaderVariant variant)
+{
+    if (!variant.IsValid() || variant.index >= int(_shaderVariants.size()))
     {
-        glDeleteShader(vertShader);
-        vertShader = 0;
+        //default constructed or requested on a ctx that has gone since, id 0 draws nothing
+        static const SmlGLProgram noProgram;
+        return noProgram;
     }
 
-    if (geomShader)
+    ShaderVariant& entry = _shaderVariants[variant.index];
+    //first use waits, a reload is only swapped in once it has linked; without parallel
+    //compile nothing links in the background, the reload is finished on its first draw
+    if (entry.pending.IsValid()
+        && (0 == entry.program.Id() || !_programCompiler.IsParallel() || IsProgramReady(entry.pending)))
     {
-        glDeleteShader(geomShader);
-        geomShader = 0;
+        SML_ALLOC_PHASE_EXEMPT("program variant"); //reflection and the cache write allocate, once per compile
+        SmlGLProgram program = WaitProgram(entry.pending);
+        entry.pending = SmlGLProgramTicket{};
+        if (!program.IsLinked() && entry.program.Id())
+        {
+            //a reload with a glsl error, the log has it; keep drawing with the old one
+            qWarning() << "SmlGLWindow: reload of" << entry.key << "failed to link, keeping the previous program";
+            glDeleteProgram(program.Id());
+        }
+        else
+        {
+            if (entry.program.Id())
+            {
+                glDeleteProgram(entry.program.Id());
+            }
+            entry.program = program;
+        }
     }
+    return entry.program;
+}
 
-    if (fragShader)
+void SmlGLWindow::ReloadProgramVariants()
+{
+    for (ShaderVariant& entry : _shaderVariants)
     {
-        glDeleteShader(fragShader);
-        fragShader = 0;
+        if (!entry.pending.IsValid())
+        {
+            entry.pending = SubmitShaderVariant(entry);
+        }
     }
+}
 
-    return programId;
+void SmlGLWindow::ReleaseShaderVariants()
+{
+    for (ShaderVariant& entry : _shaderVariants)
+    {
+        if (entry.program.Id())
+        {
+            glDeleteProgram(entry.program.Id());
+        }
+    }
+    _shaderVariants.clear(); //pending compiles are dropped by _programCompiler.Reset
 }
 
 void SmlGLWindow::ResponseCtx(/*QThread* targetThread*/)
 {
+    SML_TRACE_ZONE("SmlGLWindow::ResponseCtx");
+
     const ulong timeOut = 500;
-    bool waitOk = _ctxSemphore.Wait(timeOut);
+    bool waitOk = false;
+    {
+        SML_TRACE_ZONE("wait _ctxSemphore");
+        waitOk = _ctxSemphore.Wait(timeOut);
+    }
     if(waitOk)
     {
         _glctx->moveToThread(_thread);
@@ -395,39 +917,210 @@ void SmlGLWindow::ResponseCtx(/*QThread* targetThread*/)
     else
     {
          _ctxResponsedOk = false;
+         _pacer.FrameDropped();
     }
 
     _eventCtxResponsed.Notify(false);
 }
 
+void SmlGLWindow::SetFramesInFlight(int count)
+{
+    _framesInFlight.store(qBound(1, count, SML_MAX_FRAMES_IN_FLIGHT)); //applied by the next frame
+}
+
+void SmlGLWindow::SetCoalescedResize(bool on)
+{
+    _coalescedResize.store(on);
+}
+
+void SmlGLWindow::SetFrameBudget(int maxFps)
+{
+    _serviceFrameIntervalNs.store(maxFps > 0 ? 1000000000ll / maxFps : 0); //picked up by the next service pass
+}
+
+void SmlGLWindow::SetFramePacing(const SmlFramePacing& pacing)
+{
+    _pacer.Configure(pacing, screen() ? screen()->refreshRate() : 0);
+    _swapInterval.store(SmlPacingMode::SwapInterval == pacing.mode ? pacing.swapInterval : -1);
+
+    if (_animating)
+    {
+        SetAnimating(true); //reconnect for the new mode
+    }
+}
+
+SmlFramePacingStats SmlGLWindow::GetFramePacingStats() const
+{
+    return _pacer.Stats();
+}
+
+void SmlGLWindow::SetProfiling(bool on)
+{
+    _profiling.store(on);
+}
+
+std::vector<SmlGLScopeTiming> SmlGLWindow::GetProfileTimings() const
+{
+    return _profiler.Timings();
+}
+
+bool SmlGLWindow::EnableUniformRing(GLsizeiptr bytesPerFrame)
+{
+    return _uniformRing.Create(this, bytesPerFrame, SML_MAX_FRAMES_IN_FLIGHT);
+}
+
+void SmlGLWindow::SetGLInstrumentation(bool on)
+{
+    _glInstrumenting.store(on);
+}
+
+SmlGLCallStats SmlGLWindow::GetGLCallStats() const
+{
+    return GLCallStats();
+}
+
+bool SmlGLWindow::StartHeadless(const QSize& size, qreal dpr)
+{
+    if (_offscreen)
+    {
+        return true;
+    }
+
+    //the ctx may be created on the render thread later, a probe here fails early and clearly
+    auto* offscreen = new QOffscreenSurface{};
+    offscreen->setFormat(requestedFormat());
+    offscreen->create();
+
+    QOpenGLContext probe;
+    probe.setFormat(requestedFormat());
+    if (!offscreen->isValid() || !probe.create() || !probe.makeCurrent(offscreen))
+    {
+        qWarning() << "SmlGLWindow: no OpenGL context on the" << QGuiApplication::platformName()
+            << "platform; the offscreen plugin only gets one through GLX and needs an X display"
+            << "(xvfb-run), without one pick an EGL platform plugin, e.g. QT_QPA_PLATFORM=eglfs";
+        delete offscreen;
+        return false;
+    }
+    probe.doneCurrent();
+
+    _offscreen = offscreen;
+    ApplyResize(size, dpr); //creates the ctx and calls GLInitialize like the first resizeEvent
+    return true;
+}
+
+void SmlGLWindow::ResizeHeadless(const QSize& size, qreal dpr)
+{
+    if (_offscreen)
+    {
+        ApplyResize(size, dpr);
+    }
+}
+
+void SmlGLWindow::RenderHeadlessFrame(QImage* readback)
+{
+    if (nullptr == _offscreen)
+    {
+        return;
+    }
+
+    _eventHeadlessFrameDone.Wait(0); //drop a notification left by an earlier animated frame
+    _grabPending.store(nullptr != readback);
+    RequestRender();
+
+    //request mode hops back to this thread (ResponseCtx), keep delivering queued calls while waiting
+    while (!_eventHeadlessFrameDone.Wait(5))
+    {
+        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+    }
+
+    if (readback)
+    {
+        *readback = std::move(_grabbedFrame);
+        _grabbedFrame = QImage{};
+    }
+}
+
+void SmlGLWindow::FinishHeadless()
+{
+    if (_offscreen && !_SurfaceDestroyed)
+    {
+        _SurfaceDestroyed = true; //same as the surface event of an on screen window
+        FinalizeGL();
+    }
+}
+
+SmlFrameTimePercentiles SmlGLWindow::GetFrameTimes(SmlFrameMetric metric, int windowSeconds) const
+{
+    return _frameStats.Percentiles(metric, windowSeconds);
+}
+
+void SmlGLWindow::OnPacedFrameDone()
+{
+    int delayMs = _pacer.ScheduleNext();
+    if (delayMs > 0)
+    {
+        _paceTimer->start(delayMs); //SmlGLWindow::requestUpdate
+    }
+    else
+    {
+        requestUpdate();
+    }
+}
+
+void SmlGLWindow::CreatePaceTimer()
+{
+    _paceTimer = new QTimer{ this };
+    _paceTimer->setSingleShot(true);
+    _paceTimer->setTimerType(Qt::PreciseTimer);
+    connect(_paceTimer, &QTimer::timeout,
+            this, &SmlGLWindow::requestUpdate);
+}
+
 void SmlGLWindow::SetAnimating(bool run)
 {
     _animating = run;
+
+    disconnect(this, &SmlGLWindow::RenderFrameDoneSignal,
+               this, &SmlGLWindow::requestUpdate);
+    disconnect(this, &SmlGLWindow::RenderFrameDoneSignal,
+               this, &SmlGLWindow::OnPacedFrameDone);
+
     if (_animating)
     {
-        connect(this, &SmlGLWindow::RenderFrameDoneSignal,
-                this, &SmlGLWindow::requestUpdate);
+        if (SmlPacingMode::Unpaced == _pacer.Pacing().mode)
+        {
+            connect(this, &SmlGLWindow::RenderFrameDoneSignal,
+                    this, &SmlGLWindow::requestUpdate);
+        }
+        else
+        {
+            connect(this, &SmlGLWindow::RenderFrameDoneSignal,
+                    this, &SmlGLWindow::OnPacedFrameDone);
+        }
         requestUpdate();
     }
     else
     {
-        disconnect(this, &SmlGLWindow::RenderFrameDoneSignal,
-                   this, &SmlGLWindow::requestUpdate);
+        _paceTimer->stop();
     }
 }
 
 SmlGLWindow::SmlGLWindow(QWindow* parent,
                                      bool requestMode /*= false*/,
-                                     bool multiThreadMode /*= true*/)
+                                     bool multiThreadMode /*= true*/,
+                                     bool ctxOwnerMode /*= false*/)
     : QWindow(parent),
       _requestMode{ requestMode },
-      _multiThreadMode{ multiThreadMode }
+      _multiThreadMode{ multiThreadMode },
+      _ctxOwnerMode{ multiThreadMode && ctxOwnerMode }
 {
     setSurfaceType(QSurface::OpenGLSurface);
+    CreatePaceTimer();
 
     if (_multiThreadMode)
     {
         _thread = new QThread{ this };
+        _thread->setObjectName("SmlGLWindow render");
         _render = new SmlThreadGLRender{ nullptr, this };
         _render->moveToThread(_thread);
 
@@ -442,14 +1135,47 @@ SmlGLWindow::SmlGLWindow(QWindow* parent,
                     this, &SmlGLWindow::ResponseCtx);
         }
 
+        if (_ctxOwnerMode)
+        {
+            connect(this, &SmlGLWindow::RequestOwnerLoopSignal,
+                    _render, &SmlThreadGLRender::OwnerLoop);
+        }
+
         _thread->start();
+
+        if (_ctxOwnerMode)
+        {
+            emit RequestOwnerLoopSignal(); //SmlThreadGLRender::OwnerLoop, runs until _ownerQuit
+        }
     }
 }
 
+SmlGLWindow::SmlGLWindow(QWindow* parent, SmlGLRenderService* service)
+    : QWindow(parent),
+      _multiThreadMode{ true },
+      _ctxOwnerMode{ true },
+      _service{ service }
+{
+    setSurfaceType(QSurface::OpenGLSurface);
+    CreatePaceTimer();
+
+    _service->Attach(this);
+}
+
 SmlGLWindow::~SmlGLWindow()
 {
-    if (_multiThreadMode)
+    if (_service)
     {
+        _service->Detach(this); //the service thread releases the ctx
+    }
+    else if (_multiThreadMode)
+    {
+        if (_ctxOwnerMode)
+        {
+            _ownerQuit.store(true);
+            OwnerPost();
+        }
+
         _thread->quit();
         _thread->wait();
     }
@@ -460,4 +1186,28 @@ SmlGLWindow::~SmlGLWindow()
         _glctx = nullptr;
     }
 
+    if (_loader)
+    {
+        _loader->Stop(); //normally already stopped by FinalizeGL
+        delete _loader;
+        _loader = nullptr;
+    }
+
+    delete _offscreen; //after the ctx is released
+    _offscreen = nullptr;
+
+    delete _programCache;
+    _programCache = nullptr;
+
+    //threads are gone, nothing waits any more
+    _ctxSemphore.SetStats(nullptr);
+    _eventCtxResponsed.SetStats(nullptr);
+    _eventOwnerWake.SetStats(nullptr);
+    delete _ctxSemphoreStats;
+    delete _eventCtxResponsedStats;
+    delete _eventOwnerWakeStats;
+    _ctxSemphoreStats = nullptr;
+    _eventCtxResponsedStats = nullptr;
+    _eventOwnerWakeStats = nullptr;
+
 }
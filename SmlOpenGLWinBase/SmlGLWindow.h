@@ -12,19 +12,34 @@
 #include <QMutex>
 #include <QThread>
 #include <QWaitCondition>
+#include <QTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QImage>
 
-#if defined(_USE_OPENGL_COMPT)
-#include <QOpenGLFunctions_4_5_Compatibility>
-#define QOpenGLFunctions_PROFILE QOpenGLFunctions_4_5_Compatibility
-#else
-#include <QOpenGLFunctions_4_5_Core>
-#define QOpenGLFunctions_PROFILE QOpenGLFunctions_4_5_Core
-#endif
+#include <atomic>
+
+#include "SmlGLFunctions.h"
+#include "SmlGLInstrumentedFunctions.h"
 
 
 #include "SmlWaitObject.h"
+#include "SmlTripleBuffer.h"
+#include "SmlFramePacer.h"
+#include "SmlSpscRing.h"
+#include "SmlRenderCommand.h"
+#include "SmlGLResourceLoader.h"
+#include "SmlGLProfiler.h"
+#include "SmlFrameStats.h"
+#include "SmlUniformRing.h"
+#include "SmlGLProgram.h"
+#include "SmlGLProgramCache.h"
+#include "SmlGLProgramCompiler.h"
+#include "SmlShaderPreprocessor.h"
 
 class SmlGLWindow;
+class SmlGLRenderService;
+class SmlGLRenderWorker;
 class SmlThreadGLRender : public QObject
 {
     Q_OBJECT
@@ -37,16 +52,19 @@ public:
 
 public slots:
     void Render();
+    void OwnerLoop();
 };
 
 
 
-class SmlGLWindow : public QWindow, protected QOpenGLFunctions_PROFILE
+class SmlGLWindow : public QWindow, protected SmlGLInstrumentedFunctions
 {
     Q_OBJECT
 
 private:
     friend class SmlThreadGLRender;
+    friend class SmlGLRenderService;
+    friend class SmlGLRenderWorker;
     using SML_QTBase = QWindow;
 
 private:
@@ -69,29 +87,200 @@ private:
 
     bool _multiThreadMode{ true };
 
+    //ctx owner mode: the render thread creates and keeps the opengl context,
+    //the ui thread only posts messages (resize, render, finalize) to it
+    bool _ctxOwnerMode{ false };
+    std::atomic<bool> _ownerQuit{ false };
+    std::atomic<bool> _ownerRenderPending{ false };
+    std::atomic<bool> _ownerFinalizePending{ false };
+    bool _ownerFinalized{ false };
+    SmlEvent _eventOwnerWake{ true };
+    SmlEvent _eventOwnerFinalized{ true };
+
+    //shared render service: ctx owner mode driven by one of the service threads instead of _thread
+    SmlGLRenderService* _service{ nullptr };
+    SmlGLRenderWorker* _serviceWorker{ nullptr };
+    std::atomic<qint64> _serviceFrameIntervalNs{ 0 };
+    SmlEvent _eventOwnerReleased{ true };
+
+    //frame pacing, the pace timer lives on the ui thread
+    SmlFramePacer _pacer;
+    QTimer* _paceTimer{ nullptr };
+    std::atomic<int> _swapInterval{ -1 };
+
+    //frames in flight: the cpu may run at most _framesInFlight frames ahead of the gpu
+    inline static constexpr int SML_MAX_FRAMES_IN_FLIGHT = 3;
+    std::atomic<int> _framesInFlight{ 2 };
+    int _framesInFlightApplied{ 0 };
+    GLsync _frameFences[SML_MAX_FRAMES_IN_FLIGHT]{};
+    quint64 _frameIndex{ 0 };
+    int _frameSlot{ 0 };
+
+    //coalesced resize: the ui thread only publishes the latest size,
+    //the render thread applies it at the start of its next frame
+    struct SmlResizeRequest
+    {
+        QSize size;
+        qreal dpr{ 1.0 };
+    };
+    std::atomic<bool> _coalescedResize{ true };
+    SmlTripleBuffer<SmlResizeRequest> _resizeState;
+    QSize _appliedSize;
+
+    //ui thread -> render thread commands, drained once per frame
+    inline static constexpr size_t SML_COMMAND_CAPACITY = 256;
+    SmlSpscRing<SmlRenderCommand, SML_COMMAND_CAPACITY> _commands;
+
+    //optional background upload thread, its ctx shares with _glctx
+    SmlGLResourceLoader* _loader{ nullptr };
+
+    //optional, CreateProgram goes through it once EnableProgramCache was called
+    SmlGLProgramCache* _programCache{ nullptr };
+    //render thread, programs submitted by CreateProgramAsync, polled once per frame
+    SmlGLProgramCompiler _programCompiler;
+
+    struct ShaderVariant
+    {
+        SmlShaderFiles files;
+        QByteArrayList defines;
+        QByteArray key;             //files and sorted defines
+        SmlGLProgram program;       //0 until the first compile has been taken
+        SmlGLProgramTicket pending; //first compile or a reload, swapped in once linked
+    };
+    //render thread, owned programs, indexed by SmlShaderVariant, dropped with the ctx
+    std::vector<ShaderVariant> _shaderVariants;
+
+    //wait statistics of the ctx handoff, nullptr until EnableWaitStats
+    SmlWaitStats* _ctxSemphoreStats{ nullptr };
+    SmlWaitStats* _eventCtxResponsedStats{ nullptr };
+    SmlWaitStats* _eventOwnerWakeStats{ nullptr };
+
+    //gpu timer queries, created and dropped on the render thread when _profiling flips
+    SmlGLProfiler _profiler;
+    std::atomic<bool> _profiling{ false };
+
+    //gl call counting, applied by the render thread at the start of a frame
+    std::atomic<bool> _glInstrumenting{ false };
+
+    //always on, a couple of timestamps and one histogram bucket per frame
+    SmlFrameStats _frameStats;
+
+    //per frame uniform blocks, one region per frame slot, created by EnableUniformRing
+    SmlUniformRing _uniformRing;
+
+    //headless mode: the ctx renders into _fbo on an offscreen surface, the window is never shown
+    QOffscreenSurface* _offscreen{ nullptr };
+    QOpenGLFramebufferObject* _fbo{ nullptr }; //render thread, recreated on resize
+    std::atomic<bool> _grabPending{ false };
+    QImage _grabbedFrame; //written by the render thread before _eventHeadlessFrameDone
+    SmlEvent _eventHeadlessFrameDone{ true };
+
 
 private:
     void ThreadRender();
     void Render();
     void RequestRender();
     void FinalizeGL();
-
+    void ApplyResize(const QSize& size, qreal dpr);
+    void ResizeGL(const QSize& size, qreal dpr);
+    void ResizeGLCurrent(const QSize& size, qreal dpr);
+    void ApplyPendingResize();
+    void DrainCommands();
+    void FinalizeGLCurrent(bool derivedAlive = true); //false from the base destructor, GLFinalize is skipped
+
+    void OwnerLoop();
+    bool OwnerStep(bool renderAllowed);
+    void OwnerRelease();
+    void OwnerPost();
+
+    void CreatePaceTimer();
+
+    void BeginFrameSlot();
+    void EndFrameSlot();
+    void WaitFrameFence(int slot);
+    void ReleaseFrameFences();
+
+    bool IsHeadless() const { return nullptr != _offscreen; }
+    QSurface* Surface(); //what the ctx is made current on, the window or the offscreen surface
     bool MakeCurrentCtx(const char* msg, const char* msg1);
     void DoneCurrentCtx();
 
     void RequestCtx();
+    SmlGLProgramTicket SubmitShaderVariant(const ShaderVariant& variant);
+    void ReleaseShaderVariants();
 
-private:
-    void checkCompileErrors(GLuint shader, const char* type);
 protected:
-    GLuint CreateProgram(const GLchar* const vertSource, const GLchar* const  geomSource, const GLchar* const  fragSource);
+    //slot of the frame being painted, in [0, FramesInFlight()), index per frame resources with it
+    int FrameSlot() const { return _frameSlot; }
+    int FramesInFlight() const { return _framesInFlightApplied; }
+
+    //ui thread only, false when the queue is full and the command was dropped
+    bool PostCommand(const SmlRenderCommand& cmd);
+
+    //ui thread, call from the derived constructor to get a loader thread
+    void EnableResourceLoader();
+    //ui thread, call from the derived constructor, before any frame is requested
+    void EnableWaitStats();
+    //ui thread, call from the derived constructor; an empty dir means <cache location>/programs,
+    //SML_PROGRAM_CACHE=0 in the environment keeps it off to measure a cold start
+    void EnableProgramCache(const QString& dir = QString());
+    //upload runs on the loader thread, ready runs on the render thread before a GLPaint
+    //once the gpu has finished the upload; false when no loader is enabled or its shared ctx
+    //could not be created, the caller uploads on the render thread or keeps its placeholder
+    bool UploadAsync(SmlGLResourceLoader::UploadFunc upload, SmlGLResourceLoader::ReadyFunc ready);
+
+    //render thread, open scopes with SmlGLProfileScope scope{ Profiler(), "name" } inside GLPaint
+    SmlGLProfiler& Profiler() { return _profiler; }
+
+    //render thread, call from GLInitialize; UniformRing() hands out space in the region of
+    //the current frame slot, it is reused once the fence of that slot has passed
+    bool EnableUniformRing(GLsizeiptr bytesPerFrame);
+    SmlUniformRing& UniformRing() { return _uniformRing; }
+
+    //compiled, linked and reflected; check IsLinked(), the id is valid either way
+    SmlGLProgram CreateProgram(const GLchar* const vertSource, const GLchar* const  geomSource, const GLchar* const  fragSource);
+    //render thread; submit every program first and wait for each where it is first needed,
+    //the driver compiles them in parallel where it has GL_KHR_parallel_shader_compile;
+    //IsProgramReady turns true in a later frame without blocking; without the extension
+    //it stays false and WaitProgram compiles where the program is first used
+    SmlGLProgramTicket CreateProgramAsync(const GLchar* const vertSource, const GLchar* const  geomSource, const GLchar* const  fragSource);
+    bool IsProgramReady(SmlGLProgramTicket ticket) const;
+    SmlGLProgram WaitProgram(SmlGLProgramTicket ticket); //blocks while still compiling, once per ticket
+
+    //render thread; a cache of shader files next to CreateProgram, which stays uncached for
+    //sources the caller built and programs the caller owns: files go through
+    //SmlShaderPreprocessor with the defines, the same files and defines give the same variant
+    //and program, owned by the window; request every variant up front, ProgramVariant blocks
+    //only on first use and returns an empty program for a variant it did not hand out
+    SmlShaderVariant RequestProgramVariant(const SmlShaderFiles& files, const QByteArrayList& defines);
+    bool IsProgramVariantReady(SmlShaderVariant variant) const;
+    const SmlGLProgram& ProgramVariant(SmlShaderVariant variant);
+    //re-reads and recompiles every variant, the old programs draw until the new ones linked
+    void ReloadProgramVariants();
+
+    //render thread, through the shadowed entry points so the gl call counter sees them
+    void SetUniform(const SmlGLUniform<GLint>& uniform, GLint value) { glProgramUniform1i(uniform.program, uniform.location, value); }
+    void SetUniform(const SmlGLUniform<GLfloat>& uniform, GLfloat value) { glProgramUniform1f(uniform.program, uniform.location, value); }
+    void SetUniform(const SmlGLUniform<glm::vec2>& uniform, const glm::vec2& value) { glProgramUniform2fv(uniform.program, uniform.location, 1, &value[0]); }
+    void SetUniform(const SmlGLUniform<glm::vec3>& uniform, const glm::vec3& value) { glProgramUniform3fv(uniform.program, uniform.location, 1, &value[0]); }
+    void SetUniform(const SmlGLUniform<glm::vec4>& uniform, const glm::vec4& value) { glProgramUniform4fv(uniform.program, uniform.location, 1, &value[0]); }
+    void SetUniform(const SmlGLUniform<glm::mat4>& uniform, const glm::mat4& value) { glProgramUniformMatrix4fv(uniform.program, uniform.location, 1, GL_FALSE, &value[0][0]); }
+    void SetUniform(const SmlGLUniform<SmlGLSampler>& uniform, SmlGLSampler value) { glProgramUniform1i(uniform.program, uniform.location, value.unit); }
+    void BindUniformBlock(const SmlGLUniformBlock& block, const SmlUniformAlloc& alloc);
+    //attribute and binding index are both the location, one buffer per attribute
+    void SetVertexAttribute(GLuint vao, const SmlGLAttribute& attribute, GLint size, GLenum type,
+        GLuint buffer, GLsizei stride, GLuint divisor = 0);
 
 public slots:
     void ResponseCtx(/*QThread* targetThread*/);
 
+private slots:
+    void OnPacedFrameDone();
+
 signals:
     void RequestCtxSignal(/*QThread* targetThread*/);
     void RequestRenderSignal();
+    void RequestOwnerLoopSignal();
     void RenderFrameDoneSignal();
 
 private:
@@ -111,11 +300,38 @@ protected:
     virtual void GLResize(const QSize& size, const QSize& oldSize) = 0;
     virtual void GLPaint(QPaintDevice* paintDev) = 0;
     virtual void GLFinalize() = 0;
+    virtual void GLCommand(const SmlRenderCommand& cmd) {} //render thread, ctx current, before GLPaint
 
 public:
     void SetAnimating(bool run);
+    void SetFramesInFlight(int count); //1 - 3
+    void SetCoalescedResize(bool on); //multi threaded modes only, ctx owner mode always coalesces
+    void SetFrameBudget(int maxFps); //shared render service only, 0 means unlimited
+    void SetFramePacing(const SmlFramePacing& pacing); //swap interval is applied when the ctx is created
+    SmlFramePacingStats GetFramePacingStats() const;
+    void SetProfiling(bool on); //takes effect on the next frame
+    std::vector<SmlGLScopeTiming> GetProfileTimings() const; //results lag a few frames behind
+    void SetGLInstrumentation(bool on); //takes effect on the next frame
+    SmlGLCallStats GetGLCallStats() const;
+    SmlGLProgramCacheStats GetProgramCacheStats() const; //zeros when the cache is off
+    //any thread, over the last windowSeconds (1 - 60), gpu times lag a few frames behind
+    SmlFrameTimePercentiles GetFrameTimes(SmlFrameMetric metric, int windowSeconds = 10) const;
+
+public:
+    //headless mode, ui thread, instead of show(): works with every threading mode and never
+    //maps a window, but the platform plugin still has to hand out a gl ctx: offscreen does so
+    //only through GLX on an X display (xvfb-run), without X use an EGL plugin such as eglfs;
+    //false, with the reason logged, when no ctx can be created on an offscreen surface
+    bool StartHeadless(const QSize& size, qreal dpr = 1.0);
+    void ResizeHeadless(const QSize& size, qreal dpr = 1.0); //applied by the next frame
+    //renders one frame and waits for it, readback is optional (glReadPixels, stalls the gpu)
+    void RenderHeadlessFrame(QImage* readback = nullptr);
+    //GLFinalize, call while the derived window is still alive
+    void FinishHeadless();
 
 public:
-    SmlGLWindow(QWindow* parent, bool requestMode = false, bool multiThreadMode = true);
+    //ctxOwnerMode only takes effect together with multiThreadMode
+    SmlGLWindow(QWindow* parent, bool requestMode = false, bool multiThreadMode = true, bool ctxOwnerMode = false);
+    SmlGLWindow(QWindow* parent, SmlGLRenderService* service);
     virtual ~SmlGLWindow();
 };
@@ -0,0 +1,306 @@
+#include "SmlPerfCounters.h"
+#include "SmlTrace.h"
+
+#include <QDebug>
+
+#include <cstring>
+#include <cerrno>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+
+struct SmlPerfPhaseAccum
+{
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<quint64> scopes{ 0 };
+    std::atomic<quint64> counted[SML_PERF_EVENT_COUNT]{}; //scopes that had this event
+    std::atomic<quint64> sums[SML_PERF_EVENT_COUNT]{};
+    std::atomic<quint64> last[SML_PERF_EVENT_COUNT]{};
+};
+
+static SmlPerfPhaseAccum g_perfPhases[SmlPerfCounters::SML_PERF_MAX_PHASES];
+static std::atomic<bool> g_perfWarned{ false };
+
+static const char* const SML_PERF_EVENT_NAMES[SML_PERF_EVENT_COUNT] =
+{
+    "cycles", "instructions", "cacheMisses", "branchMisses"
+};
+
+//counter track keys, the raw cycle and instruction counts are in the stats
+static const char* const SML_PERF_TRACE_KEYS[SmlTraceCounter::SML_TRACE_COUNTER_VALUES] =
+{
+    "ipc", "cacheMisses", "branchMisses", nullptr
+};
+
+
+void SmlPerfThreadCounters::Open()
+{
+    _tried = true;
+
+#if defined(__linux__)
+    static const quint64 configs[SML_PERF_EVENT_COUNT] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    int leader = -1;
+    int lastErrno = 0;
+    for (int ee = 0; ee < SML_PERF_EVENT_COUNT; ++ee)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[ee];
+        attr.disabled = -1 == leader ? 1 : 0; //the group starts together once complete
+        attr.exclude_kernel = 1; //allowed up to perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = int(syscall(SYS_perf_event_open, &attr, 0 /*this thread*/, -1 /*any cpu*/, leader, 0));
+        if (fd < 0)
+        {
+            lastErrno = errno;
+            if (-1 == leader)
+            {
+                break; //no cycles, no ipc, nothing worth reading
+            }
+            continue; //e.g. no cache miss event on this cpu, the others still count
+        }
+
+        if (-1 == leader)
+        {
+            leader = fd;
+        }
+        _fds[ee] = fd;
+        _groupIndex[ee] = _opened++;
+    }
+
+    if (-1 != leader)
+    {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    if (lastErrno && !g_perfWarned.exchange(true))
+    {
+        qWarning() << "SmlPerfCounters:" << (-1 == leader ? "hardware counters unavailable," : "some counters unavailable,")
+            << strerror(lastErrno);
+    }
+#else
+    if (!g_perfWarned.exchange(true))
+    {
+        qWarning() << "SmlPerfCounters: hardware counters need linux perf_event_open";
+    }
+#endif
+}
+
+SmlPerfThreadCounters::~SmlPerfThreadCounters()
+{
+#if defined(__linux__)
+    //members first, the leader owns the group
+    for (int ee = SML_PERF_EVENT_COUNT - 1; ee >= 0; --ee)
+    {
+        if (_fds[ee] >= 0)
+        {
+            close(_fds[ee]);
+        }
+    }
+#endif
+}
+
+quint32 SmlPerfThreadCounters::Read(SmlPerfReading& reading)
+{
+    if (!_tried)
+    {
+        Open();
+    }
+    if (0 == _opened)
+    {
+        return 0;
+    }
+
+#if defined(__linux__)
+    //PERF_FORMAT_GROUP: nr, time enabled, time running, one value per opened event
+    quint64 buffer[3 + SML_PERF_EVENT_COUNT];
+    ssize_t bytes = read(_fds[SML_PERF_CYCLES], buffer, sizeof(buffer));
+    if (bytes < ssize_t(sizeof(quint64) * (3 + _opened)))
+    {
+        return 0;
+    }
+
+    reading.enabledNs = buffer[1];
+    reading.runningNs = buffer[2];
+
+    quint32 mask = 0;
+    for (int ee = 0; ee < SML_PERF_EVENT_COUNT; ++ee)
+    {
+        if (_groupIndex[ee] >= 0)
+        {
+            reading.values[ee] = buffer[3 + _groupIndex[ee]];
+            mask |= 1u << ee;
+        }
+        else
+        {
+            reading.values[ee] = 0;
+        }
+    }
+    return mask;
+#else
+    return 0;
+#endif
+}
+
+quint32 SmlPerfReading::Delta(const SmlPerfReading& begin, const SmlPerfReading& end, quint32 mask, quint64 delta[SML_PERF_EVENT_COUNT])
+{
+    quint64 enabled = end.enabledNs - begin.enabledNs;
+    quint64 running = end.runningNs - begin.runningNs;
+    if (0 == running || end.runningNs < begin.runningNs)
+    {
+        mask = 0; //the group was never on the pmu inside the scope, nothing to extrapolate from
+    }
+    double scale = running < enabled ? double(enabled) / double(running) : 1.0;
+
+    for (int ee = 0; ee < SML_PERF_EVENT_COUNT; ++ee)
+    {
+        bool valid = (mask & (1u << ee)) && end.values[ee] >= begin.values[ee];
+        delta[ee] = valid ? quint64(double(end.values[ee] - begin.values[ee]) * scale) : 0;
+        if (!valid)
+        {
+            mask &= ~(1u << ee);
+        }
+    }
+    return mask;
+}
+
+/////////////////////////////////////////////////////////////////
+SmlPerfThreadCounters& SmlPerfCounters::ThreadCounters()
+{
+    static thread_local SmlPerfThreadCounters counters;
+    return counters;
+}
+
+bool SmlPerfCounters::Available()
+{
+    SmlPerfReading reading;
+    return 0 != (ThreadCounters().Read(reading) & (1u << SML_PERF_CYCLES));
+}
+
+void SmlPerfCounters::Record(const char* phase, const quint64 delta[SML_PERF_EVENT_COUNT], quint32 validMask)
+{
+    SmlPerfPhaseAccum* accum = nullptr;
+    for (SmlPerfPhaseAccum& slot : g_perfPhases)
+    {
+        const char* name = slot.name.load(std::memory_order_acquire);
+        if (nullptr == name && slot.name.compare_exchange_strong(name, phase, std::memory_order_acq_rel))
+        {
+            name = phase;
+        }
+        if (name == phase || 0 == strcmp(name, phase))
+        {
+            accum = &slot;
+            break;
+        }
+    }
+    if (nullptr == accum)
+    {
+        return; //phase table full
+    }
+
+    accum->scopes.fetch_add(1, std::memory_order_relaxed);
+    for (int ee = 0; ee < SML_PERF_EVENT_COUNT; ++ee)
+    {
+        if (validMask & (1u << ee))
+        {
+            accum->counted[ee].fetch_add(1, std::memory_order_relaxed);
+            accum->sums[ee].fetch_add(delta[ee], std::memory_order_relaxed);
+            accum->last[ee].store(delta[ee], std::memory_order_relaxed);
+        }
+    }
+}
+
+std::vector<SmlPerfPhaseStats> SmlPerfCounters::All()
+{
+    std::vector<SmlPerfPhaseStats> phases;
+    for (const SmlPerfPhaseAccum& accum : g_perfPhases)
+    {
+        const char* name = accum.name.load(std::memory_order_acquire);
+        if (nullptr == name)
+        {
+            break;
+        }
+
+        SmlPerfPhaseStats stats;
+        stats.phase = name;
+        stats.scopes = accum.scopes.load(std::memory_order_relaxed);
+        double sums[SML_PERF_EVENT_COUNT]{};
+        for (int ee = 0; ee < SML_PERF_EVENT_COUNT; ++ee)
+        {
+            quint64 counted = accum.counted[ee].load(std::memory_order_relaxed);
+            stats.available[ee] = counted > 0;
+            sums[ee] = double(accum.sums[ee].load(std::memory_order_relaxed));
+            stats.perScope[ee] = counted ? sums[ee] / counted : 0;
+            stats.last[ee] = double(accum.last[ee].load(std::memory_order_relaxed));
+        }
+        stats.ipc = sums[SML_PERF_CYCLES] > 0 ? sums[SML_PERF_INSTRUCTIONS] / sums[SML_PERF_CYCLES] : 0;
+        stats.lastIpc = stats.last[SML_PERF_CYCLES] > 0 ? stats.last[SML_PERF_INSTRUCTIONS] / stats.last[SML_PERF_CYCLES] : 0;
+        phases.push_back(stats);
+    }
+    return phases;
+}
+
+void SmlPerfCounters::DumpAll()
+{
+    for (const SmlPerfPhaseStats& stats : All())
+    {
+        QDebug debug = qDebug().nospace();
+        debug << stats.phase << ": scopes " << stats.scopes;
+        if (!stats.available[SML_PERF_CYCLES])
+        {
+            debug << " (no hardware counters)";
+            continue;
+        }
+
+        debug << " ipc " << stats.ipc;
+        for (int ee = 0; ee < SML_PERF_EVENT_COUNT; ++ee)
+        {
+            if (stats.available[ee])
+            {
+                debug << " " << SML_PERF_EVENT_NAMES[ee] << "/scope " << stats.perScope[ee];
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////
+SmlPerfScope::~SmlPerfScope()
+{
+    SmlPerfReading end;
+    quint32 mask = _validMask ? _validMask & SmlPerfCounters::ThreadCounters().Read(end) : 0;
+
+    quint64 delta[SML_PERF_EVENT_COUNT]{};
+    mask = SmlPerfReading::Delta(_begin, end, mask, delta);
+    SmlPerfCounters::Record(_name, delta, mask);
+
+#if defined(SML_ENABLE_TRACE)
+    if (mask & (1u << SML_PERF_CYCLES))
+    {
+        SmlTraceCounter counter;
+        counter.name = _name;
+        counter.keys = SML_PERF_TRACE_KEYS;
+        counter.ticks = SmlTrace::NowTicks();
+        counter.values[0] = delta[SML_PERF_CYCLES] ? double(delta[SML_PERF_INSTRUCTIONS]) / double(delta[SML_PERF_CYCLES]) : 0;
+        counter.values[1] = double(delta[SML_PERF_CACHE_MISSES]);
+        counter.values[2] = double(delta[SML_PERF_BRANCH_MISSES]);
+        SmlTrace::ThreadBuffer()->PushCounter(counter);
+    }
+#endif
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+//hardware counters (cycles, instructions, cache and branch misses) around named scopes,
+//read through perf_event_open on linux; the SML_PERF_ macros compile to nothing unless
+//the build defines SML_ENABLE_PERF_COUNTERS (cmake -DSML_ENABLE_PERF_COUNTERS=ON)
+//where the counters can not be opened (other platforms, most VMs, perf_event_paranoid)
+//a scope only counts how often it ran and Available() is false
+//a scope costs two read() syscalls, meant for a handful of phases per frame
+#if defined(SML_ENABLE_PERF_COUNTERS)
+#define SML_PERF_CONCAT_(a, b) a##b
+#define SML_PERF_CONCAT(a, b) SML_PERF_CONCAT_(a, b)
+#define SML_PERF_SCOPE(name) SmlPerfScope SML_PERF_CONCAT(_smlPerfScope, __LINE__){ name }
+#define SML_PERF_DUMP() SmlPerfCounters::DumpAll()
+#else
+#define SML_PERF_SCOPE(name) do {} while (0)
+#define SML_PERF_DUMP() do {} while (0)
+#endif
+
+
+enum SmlPerfEvent
+{
+    SML_PERF_CYCLES,
+    SML_PERF_INSTRUCTIONS,
+    SML_PERF_CACHE_MISSES,
+    SML_PERF_BRANCH_MISSES,
+
+    SML_PERF_EVENT_COUNT
+};
+
+struct SmlPerfPhaseStats
+{
+    const char* phase{ nullptr };
+    quint64 scopes{ 0 };        //times the scope ran, one per frame for the render phases
+    bool available[SML_PERF_EVENT_COUNT]{};
+    double perScope[SML_PERF_EVENT_COUNT]{}; //averages, 0 where not available
+    double last[SML_PERF_EVENT_COUNT]{};     //latest scope
+    double ipc{ 0 };            //instructions / cycles over all scopes
+    double lastIpc{ 0 };
+};
+
+
+//raw running totals of a counter group; the kernel counts only while the group is on the
+//pmu, a delta is scaled by how long it ran between two readings, not by the totals' ratio
+struct SmlPerfReading
+{
+    quint64 values[SML_PERF_EVENT_COUNT]{};
+    quint64 enabledNs{ 0 };
+    quint64 runningNs{ 0 };
+
+    //delta over [begin, end] extrapolated to the time enabled, returns the mask still valid
+    static quint32 Delta(const SmlPerfReading& begin, const SmlPerfReading& end, quint32 mask, quint64 delta[SML_PERF_EVENT_COUNT]);
+};
+
+
+//the counter group of one thread, opened on the first scope of that thread
+class SmlPerfThreadCounters final
+{
+private:
+    int _fds[SML_PERF_EVENT_COUNT]{ -1, -1, -1, -1 };
+    int _groupIndex[SML_PERF_EVENT_COUNT]{ -1, -1, -1, -1 }; //position in the group read, -1 when not opened
+    int _opened{ 0 };
+    bool _tried{ false };
+
+private:
+    void Open();
+
+public:
+    SmlPerfThreadCounters() = default;
+    ~SmlPerfThreadCounters();
+
+    SmlPerfThreadCounters(const SmlPerfThreadCounters&) = delete;
+    SmlPerfThreadCounters& operator=(const SmlPerfThreadCounters&) = delete;
+
+    //unscaled running totals of this thread with the group's times,
+    //returns the mask of events that are valid, 0 when nothing could be read
+    quint32 Read(SmlPerfReading& reading);
+};
+
+
+class SmlPerfCounters final
+{
+public:
+    inline static constexpr int SML_PERF_MAX_PHASES = 32;
+
+public:
+    static SmlPerfThreadCounters& ThreadCounters();
+
+    //true when the cycle counter can be opened on the calling thread
+    static bool Available();
+
+    static void Record(const char* phase, const quint64 delta[SML_PERF_EVENT_COUNT], quint32 validMask);
+
+    //any thread
+    static std::vector<SmlPerfPhaseStats> All();
+    static void DumpAll();
+};
+
+
+class SmlPerfScope final
+{
+private:
+    const char* _name{ nullptr };
+    SmlPerfReading _begin;
+    quint32 _validMask{ 0 };
+
+public:
+    explicit SmlPerfScope(const char* name) :
+        _name{ name }
+    {
+        _validMask = SmlPerfCounters::ThreadCounters().Read(_begin);
+    }
+
+    ~SmlPerfScope();
+
+    SmlPerfScope(const SmlPerfScope&) = delete;
+    SmlPerfScope& operator=(const SmlPerfScope&) = delete;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QtGlobal>
+
+enum class SmlRenderCommandType : quint8
+{
+    KeyInput,
+    CameraOp,
+    Resource,
+};
+
+enum class SmlCameraOp : quint8
+{
+    Reset,
+    Translate,
+    Rotate,
+};
+
+//plain value sent from the ui thread to the render thread through SmlSpscRing,
+//resize is not a command, it goes through the coalesced latest size slot
+struct SmlRenderCommand
+{
+    SmlRenderCommandType type{ SmlRenderCommandType::KeyInput };
+
+    union
+    {
+        struct
+        {
+            int key;
+            int modifiers;
+        } keyInput;
+
+        struct
+        {
+            SmlCameraOp op;
+            float x;
+            float y;
+            float z;
+            float radians;
+        } camera;
+
+        struct
+        {
+            int id; //meaning is up to the derived window
+            int arg;
+        } resource;
+    };
+
+    static SmlRenderCommand KeyInput(int key, int modifiers)
+    {
+        SmlRenderCommand cmd;
+        cmd.type = SmlRenderCommandType::KeyInput;
+        cmd.keyInput = { key, modifiers };
+        return cmd;
+    }
+
+    static SmlRenderCommand Camera(SmlCameraOp op, float x = 0, float y = 0, float z = 0, float radians = 0)
+    {
+        SmlRenderCommand cmd;
+        cmd.type = SmlRenderCommandType::CameraOp;
+        cmd.camera = { op, x, y, z, radians };
+        return cmd;
+    }
+
+    static SmlRenderCommand Resource(int id, int arg = 0)
+    {
+        SmlRenderCommand cmd;
+        cmd.type = SmlRenderCommandType::Resource;
+        cmd.resource = { id, arg };
+        return cmd;
+    }
+};
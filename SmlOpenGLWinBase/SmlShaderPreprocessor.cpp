@@ -0,0 +1,93 @@
+#include "SmlShaderPreprocessor.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+static QByteArray SmlLineDirective(int line, int fileIndex)
+{
+    return "#line " + QByteArray::number(line) + " " + QByteArray::number(fileIndex) + "\n";
+}
+
+bool SmlShaderPreprocessor::Expand(const QString& path, const QByteArrayList& defines)
+{
+    _defines = defines;
+    _files.clear();
+    _source.clear();
+    return Append(QDir::cleanPath(path), 0);
+}
+
+bool SmlShaderPreprocessor::Append(const QString& path, int depth)
+{
+    if (depth > SML_MAX_INCLUDE_DEPTH)
+    {
+        qWarning() << "SmlShaderPreprocessor: includes nested deeper than" << SML_MAX_INCLUDE_DEPTH << "at" << path;
+        return false;
+    }
+
+    QFile file{ path };
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+    {
+        qWarning() << "SmlShaderPreprocessor: can not open" << path;
+        return false;
+    }
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    file.close();
+
+    const int fileIndex = _files.size();
+    _files << path;
+    if (depth > 0)
+    {
+        _source += SmlLineDirective(1, fileIndex);
+    }
+
+    int lineNumber = 0;
+    for (const QByteArray& line : lines)
+    {
+        ++lineNumber;
+        const QByteArray directive = line.trimmed();
+
+        if (directive.startsWith("#version"))
+        {
+            if (depth > 0)
+            {
+                _source += '\n'; //only the top file has one, the line count stays right
+                continue;
+            }
+
+            _source += line + '\n';
+            for (const QByteArray& define : _defines)
+            {
+                int equal = define.indexOf('=');
+                _source += "#define " + (equal < 0 ? define : define.left(equal) + " " + define.mid(equal + 1)) + "\n";
+            }
+            _source += SmlLineDirective(lineNumber + 1, fileIndex);
+            continue;
+        }
+
+        if (directive.startsWith("#include"))
+        {
+            int open = directive.indexOf('"');
+            int close = directive.lastIndexOf('"');
+            if (open < 0 || close <= open)
+            {
+                qWarning() << "SmlShaderPreprocessor:" << path << "line" << lineNumber << "expects #include \"file\"";
+                return false;
+            }
+
+            QString name = QString::fromUtf8(directive.mid(open + 1, close - open - 1));
+            //cleaned, so "../common.glsl" from a sub folder is the same file as "common.glsl"
+            QString includePath = QDir::cleanPath(QFileInfo{ path }.path() + "/" + name);
+            if (!_files.contains(includePath) && !Append(includePath, depth + 1))
+            {
+                return false;
+            }
+            _source += SmlLineDirective(lineNumber + 1, fileIndex);
+            continue;
+        }
+
+        _source += line + '\n';
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QString>
+#include <QStringList>
+
+//source files of a program, qrc or disk paths, geom may be empty
+struct SmlShaderFiles
+{
+    QString vert;
+    QString geom;
+    QString frag;
+};
+
+//a program variant of SmlGLWindow, one per distinct files and defines
+struct SmlShaderVariant
+{
+    int index{ -1 };
+
+    bool IsValid() const { return index >= 0; }
+};
+
+//glsl front end: #include "file" is resolved relative to the including file and every
+//file is pasted once; defines ("NAME" or "NAME=VALUE") are injected right after #version,
+//so features compile into their own variant with #ifdef instead of a runtime branch
+//#line directives keep compiler messages pointing into the right file, the source string
+//number is the position of the file in Files()
+class SmlShaderPreprocessor final
+{
+private:
+    inline static constexpr int SML_MAX_INCLUDE_DEPTH = 16;
+
+    QByteArrayList _defines;
+    QStringList _files;
+    QByteArray _source;
+
+private:
+    bool Append(const QString& path, int depth);
+
+public:
+    //false when a file can not be read, the reason is logged
+    bool Expand(const QString& path, const QByteArrayList& defines);
+
+    const QByteArray& Source() const { return _source; }
+    const QStringList& Files() const { return _files; }
+};
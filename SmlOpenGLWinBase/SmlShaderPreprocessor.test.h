@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#include "SmlShaderPreprocessor.h"
+
+class SmlShaderPreprocessorTest
+{
+private:
+    static bool WriteFile(const QString& path, const QByteArray& text)
+    {
+        QFile file{ path };
+        return file.open(QFile::WriteOnly | QFile::Truncate) && text.size() == file.write(text);
+    }
+
+    static void Check(const char* name, bool ok)
+    {
+        if (ok)
+        {
+            qDebug() << "shader preprocessor" << name << "ok";
+        }
+        else
+        {
+            qWarning() << "shader preprocessor" << name << "FAILED";
+        }
+    }
+
+public:
+    //main.glsl includes common.glsl twice and sub/other.glsl, which includes ../common.glsl again
+    static void Case0_IncludesAndDefines()
+    {
+        QTemporaryDir dir;
+        if (!dir.isValid()
+            || !QDir{ dir.path() }.mkdir("sub")
+            || !WriteFile(dir.filePath("main.glsl"),
+                "#version 450 core\n"
+                "#include \"common.glsl\"\n"
+                "#include \"common.glsl\"\n"
+                "#include \"sub/other.glsl\"\n"
+                "void main() {}")
+            || !WriteFile(dir.filePath("common.glsl"),
+                "float Common() { return 1.0; }")
+            || !WriteFile(dir.filePath("sub/other.glsl"),
+                "#include \"../common.glsl\"\n"
+                "float Other() { return Common(); }"))
+        {
+            qWarning() << "shader preprocessor: can not write the test files to" << dir.path();
+            return;
+        }
+
+        SmlShaderPreprocessor preprocessor;
+        bool expanded = preprocessor.Expand(dir.filePath("main.glsl"), { "SML_FOG", "SML_LEVEL=2" });
+        const QByteArray& source = preprocessor.Source();
+        Check("expand", expanded);
+
+        Check("include once", 3 == preprocessor.Files().size()
+            && 1 == source.count("float Common()"));
+
+        Check("define injection", source.startsWith(
+            "#version 450 core\n"
+            "#define SML_FOG\n"
+            "#define SML_LEVEL 2\n"
+            "#line 2 0\n"));
+
+        //source string numbers follow Files(): 0 main, 1 common, 2 other
+        Check("#line numbering", source ==
+            "#version 450 core\n"
+            "#define SML_FOG\n"
+            "#define SML_LEVEL 2\n"
+            "#line 2 0\n"
+            "#line 1 1\n"
+            "float Common() { return 1.0; }\n"
+            "#line 3 0\n"
+            "#line 4 0\n"
+            "#line 1 2\n"
+            "#line 2 2\n"
+            "float Other() { return Common(); }\n"
+            "#line 5 0\n"
+            "void main() {}\n");
+
+        WriteFile(dir.filePath("broken.glsl"), "#version 450 core\n#include \"missing.glsl\"\n");
+        Check("missing include", !preprocessor.Expand(dir.filePath("broken.glsl"), {}));
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <QThread>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+
+#include "SmlWaitObject.h"
+#include "SmlTripleBuffer.h"
+#include "SmlFramePacer.h"
+#include "SmlTrace.h"
+#include "SmlPerfCounters.h"
+
+//fixed timestep simulation on its own thread
+//the tick always advances the state by the same dt, the render thread samples the
+//state in between the last two ticks, TState must provide
+//static TState Interpolate(const TState& from, const TState& to, float ratio)
+template<typename TState>
+class SmlSimulation final : public QThread
+{
+public:
+	using TickFunc = std::function<void(TState& state, double dtSeconds)>;
+
+private:
+	struct Frame
+	{
+		TState prev;
+		TState curr;
+		qint64 currTickNs{ 0 }; //scheduled time of curr
+	};
+
+	inline static constexpr int SML_MAX_CATCH_UP = 5; //ticks per wake before the backlog is dropped
+
+	TickFunc _tick;
+	qint64 _stepNs{ 0 };
+	TState _initState;
+
+	std::atomic<bool> _quit{ false };
+	std::atomic<bool> _running{ false };
+	SmlEvent _eventWake{ true };
+
+	SmlTripleBuffer<TState> _inputState;  //ui thread -> simulation thread
+	SmlTripleBuffer<Frame> _outputFrame;  //simulation thread -> render thread
+
+private:
+	virtual void run() override
+	{
+		const double stepSeconds = _stepNs / 1e9;
+
+		Frame frame;
+		frame.prev = _initState;
+		frame.curr = _initState;
+		qint64 next = SmlFramePacer::NowNs();
+
+		const ulong SML_INFINITE = -1UL;
+		while (!_quit.load())
+		{
+			if (!_running.load() && !_inputState.HasNew())
+			{
+				//paused, nothing changes until SetRunning, SetState or Stop
+				_eventWake.Wait(SML_INFINITE);
+				next = SmlFramePacer::NowNs(); //no catch up over the pause
+				continue;
+			}
+
+			qint64 now = SmlFramePacer::NowNs();
+			if (now < next)
+			{
+				uint waitMs = uint((next - now) / 1000000);
+				if (waitMs)
+				{
+					_eventWake.Wait(waitMs); //wakes early for Stop, the rest below
+				}
+				else
+				{
+					QThread::usleep((next - now + 999) / 1000); //sub ms remainder sleeps instead of spinning
+				}
+				continue;
+			}
+
+			SML_TRACE_ZONE("SmlSimulation tick");
+			SML_PERF_SCOPE("scene update");
+			for (int ii = 0; ii < SML_MAX_CATCH_UP && now >= next; ++ii)
+			{
+				if (_inputState.HasNew())
+				{
+					frame.curr = _inputState.Read(); //state replaced from outside, no blending across it
+				}
+
+				frame.prev = frame.curr;
+				if (_running.load())
+				{
+					_tick(frame.curr, stepSeconds);
+				}
+				frame.currTickNs = next;
+				next += _stepNs;
+			}
+
+			if (now >= next)
+			{
+				next = now + _stepNs; //too far behind, drop the backlog instead of spiraling
+			}
+
+			_outputFrame.Publish(frame);
+		}
+	}
+
+public:
+	SmlSimulation(int tickHz, TickFunc tick, const TState& init) :
+		_tick{ std::move(tick) },
+		_stepNs{ 1000000000ll / std::max(tickHz, 1) },
+		_initState{ init }
+	{
+		Frame frame;
+		frame.prev = init;
+		frame.curr = init;
+		_outputFrame.Publish(frame); //sampled until the first tick
+
+		setObjectName("SmlSimulation");
+	}
+
+	virtual ~SmlSimulation() override
+	{
+		Stop();
+	}
+
+	//ui thread
+	void SetState(const TState& state)
+	{
+		_inputState.Publish(state);
+		_eventWake.Notify(false); //picked up even while paused
+	}
+
+	void SetRunning(bool running)
+	{
+		_running.store(running);
+		_eventWake.Notify(false);
+	}
+
+	void Stop()
+	{
+		_quit.store(true);
+		_eventWake.Notify(false);
+		wait();
+	}
+
+	//render thread, state at nowNs blended between the last two ticks
+	TState Sample(qint64 nowNs)
+	{
+		const Frame& frame = _outputFrame.Read();
+		float ratio = float(nowNs - frame.currTickNs) / float(_stepNs);
+		ratio = std::clamp(ratio, 0.0f, 1.0f);
+		return TState::Interpolate(frame.prev, frame.curr, ratio);
+	}
+};
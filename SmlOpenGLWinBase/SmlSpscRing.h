@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+//bounded lock free single producer / single consumer ring
+//producer and consumer indices live on their own cache lines, each side caches the
+//other side's index and only reloads it when the ring looks full or empty
+template<typename T, size_t N>
+class SmlSpscRing final
+{
+	static_assert(N >= 2 && 0 == (N & (N - 1)), "capacity must be a power of two");
+
+private:
+	inline static constexpr size_t SML_MASK = N - 1;
+
+	struct alignas(64) ProducerSide
+	{
+		std::atomic<size_t> tail{ 0 };
+		size_t headCached{ 0 };
+	};
+
+	struct alignas(64) ConsumerSide
+	{
+		std::atomic<size_t> head{ 0 };
+		size_t tailCached{ 0 };
+	};
+
+	ProducerSide _producer;
+	ConsumerSide _consumer;
+	alignas(64) T _items[N]{};
+
+public:
+	SmlSpscRing() = default;
+	SmlSpscRing(const SmlSpscRing&) = delete;
+	SmlSpscRing& operator=(const SmlSpscRing&) = delete;
+
+	//producer thread only, false when the ring is full
+	bool TryPush(const T& item)
+	{
+		size_t tail = _producer.tail.load(std::memory_order_relaxed);
+		if (tail - _producer.headCached == N)
+		{
+			_producer.headCached = _consumer.head.load(std::memory_order_acquire);
+			if (tail - _producer.headCached == N)
+			{
+				return false;
+			}
+		}
+
+		_items[tail & SML_MASK] = item;
+		_producer.tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//consumer thread only, false when the ring is empty
+	bool TryPop(T& item)
+	{
+		size_t head = _consumer.head.load(std::memory_order_relaxed);
+		if (head == _consumer.tailCached)
+		{
+			_consumer.tailCached = _producer.tail.load(std::memory_order_acquire);
+			if (head == _consumer.tailCached)
+			{
+				return false;
+			}
+		}
+
+		item = _items[head & SML_MASK];
+		_consumer.head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//consumer thread only, pops what was pushed up to now, returns the count
+	template<typename FUNC>
+	size_t Drain(FUNC func)
+	{
+		size_t head = _consumer.head.load(std::memory_order_relaxed);
+		size_t tail = _producer.tail.load(std::memory_order_acquire);
+		_consumer.tailCached = tail;
+
+		for (size_t index = head; index != tail; ++index)
+		{
+			func(static_cast<const T&>(_items[index & SML_MASK]));
+		}
+
+		_consumer.head.store(tail, std::memory_order_release);
+		return tail - head;
+	}
+};
@@ -0,0 +1,162 @@
+#include "SmlTrace.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QFile>
+#include <QDebug>
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+
+struct SmlTraceRegistry
+{
+    QMutex mutex;
+    std::vector<std::unique_ptr<SmlTraceBuffer>> buffers; //kept until exit, a thread may be gone before the export
+    quint64 nextTid{ 1 };
+
+    //tick -> ns calibration, taken at the first zone and again on export
+    qint64 originTicks{ 0 };
+    qint64 originNs{ 0 };
+};
+
+static SmlTraceRegistry& SmlRegistry()
+{
+    static SmlTraceRegistry registry;
+    return registry;
+}
+
+SmlTraceBuffer* SmlTrace::Register()
+{
+    auto buffer = std::make_unique<SmlTraceBuffer>();
+
+    SmlTraceRegistry& registry = SmlRegistry();
+    QMutexLocker<QMutex> locker{ &registry.mutex };
+    buffer->_tid = registry.nextTid++;
+    if (0 == registry.originNs)
+    {
+        registry.originTicks = NowTicks();
+        registry.originNs = NowNs();
+    }
+
+    QThread* thread = QThread::currentThread();
+    QString name = thread ? thread->objectName() : QString{};
+    buffer->_threadName = name.isEmpty() ? QByteArray{ "thread " } + QByteArray::number(buffer->_tid) : name.toUtf8();
+
+    registry.buffers.push_back(std::move(buffer));
+    return registry.buffers.back().get();
+}
+
+void SmlTrace::SetThreadName(const char* name)
+{
+    SmlTraceBuffer* buffer = ThreadBuffer();
+
+    QMutexLocker<QMutex> locker{ &SmlRegistry().mutex };
+    buffer->_threadName = name;
+}
+
+static void SmlAppendJsonString(QByteArray& out, const char* str)
+{
+    out += '"';
+    for (const char* ch = str; ch && *ch; ++ch)
+    {
+        if ('"' == *ch || '\\' == *ch)
+        {
+            out += '\\';
+        }
+        out += *ch;
+    }
+    out += '"';
+}
+
+bool SmlTrace::WriteChromeJson(const QString& fileName)
+{
+    SmlTraceRegistry& registry = SmlRegistry();
+    QMutexLocker<QMutex> locker{ &registry.mutex };
+
+    //timestamps relative to the first recorded zone, in microseconds as chrome expects
+    qint64 originTicks = std::numeric_limits<qint64>::max();
+    for (const auto& buffer : registry.buffers)
+    {
+        size_t count = buffer->_count.load(std::memory_order_acquire);
+        for (size_t ii = 0; ii < count; ++ii)
+        {
+            originTicks = std::min(originTicks, buffer->_events[ii].beginTicks);
+        }
+    }
+
+    qint64 elapsedTicks = NowTicks() - registry.originTicks;
+    qint64 elapsedNs = NowNs() - registry.originNs;
+    const double usPerTick = elapsedTicks > 0 ? elapsedNs / 1e3 / elapsedTicks : 1e-3;
+
+    QByteArray out;
+    out.reserve(1 << 20);
+    out += "{\"traceEvents\":[\n";
+
+    bool first = true;
+    auto separator = [&out, &first]()
+    {
+        out += first ? "" : ",\n";
+        first = false;
+    };
+
+    for (const auto& buffer : registry.buffers)
+    {
+        separator();
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(buffer->_tid) + ",\"args\":{\"name\":";
+        SmlAppendJsonString(out, buffer->_threadName.constData());
+        out += "}}";
+
+        size_t count = buffer->_count.load(std::memory_order_acquire);
+        for (size_t ii = 0; ii < count; ++ii)
+        {
+            const SmlTraceEvent& event = buffer->_events[ii];
+
+            separator();
+            out += "{\"name\":";
+            SmlAppendJsonString(out, event.name);
+            out += ",\"cat\":\"sml\",\"ph\":\"X\",\"pid\":1,\"tid\":" + QByteArray::number(buffer->_tid);
+            out += ",\"ts\":" + QByteArray::number((event.beginTicks - originTicks) * usPerTick, 'f', 3);
+            out += ",\"dur\":" + QByteArray::number((event.endTicks - event.beginTicks) * usPerTick, 'f', 3);
+            out += "}";
+        }
+
+        size_t counterCount = buffer->_counterCount.load(std::memory_order_acquire);
+        for (size_t ii = 0; ii < counterCount; ++ii)
+        {
+            const SmlTraceCounter& counter = buffer->_counters[ii];
+
+            separator();
+            out += "{\"name\":";
+            SmlAppendJsonString(out, counter.name);
+            out += ",\"cat\":\"sml\",\"ph\":\"C\",\"pid\":1,\"tid\":" + QByteArray::number(buffer->_tid);
+            out += ",\"ts\":" + QByteArray::number(std::max<qint64>(counter.ticks - originTicks, 0) * usPerTick, 'f', 3);
+            out += ",\"args\":{";
+            for (int vv = 0; vv < SmlTraceCounter::SML_TRACE_COUNTER_VALUES && counter.keys[vv]; ++vv)
+            {
+                out += vv ? "," : "";
+                SmlAppendJsonString(out, counter.keys[vv]);
+                out += ":" + QByteArray::number(counter.values[vv], 'g', 6);
+            }
+            out += "}}";
+        }
+
+        quint64 dropped = buffer->_dropped.load(std::memory_order_relaxed);
+        if (dropped)
+        {
+            qWarning() << "SmlTrace:" << dropped << "zones dropped on" << buffer->_threadName;
+        }
+    }
+    out += "\n]}\n";
+    locker.unlock();
+
+    QFile file{ fileName };
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return false;
+    }
+    return file.write(out) == out.size();
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+
+#include <atomic>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//scoped trace zones, recorded per thread and written out as chrome trace json
+//(chrome://tracing, ui.perfetto.dev); the SML_TRACE_ macros compile to nothing unless
+//the build defines SML_ENABLE_TRACE (cmake -DSML_ENABLE_TRACE=ON)
+#if defined(SML_ENABLE_TRACE)
+#define SML_TRACE_CONCAT_(a, b) a##b
+#define SML_TRACE_CONCAT(a, b) SML_TRACE_CONCAT_(a, b)
+#define SML_TRACE_ZONE(name) SmlTraceZone SML_TRACE_CONCAT(_smlTraceZone, __LINE__){ name }
+#define SML_TRACE_THREAD(name) SmlTrace::SetThreadName(name)
+#define SML_TRACE_EXPORT(fileName) SmlTrace::WriteChromeJson(fileName)
+#else
+#define SML_TRACE_ZONE(name) do {} while (0)
+#define SML_TRACE_THREAD(name) do {} while (0)
+#define SML_TRACE_EXPORT(fileName) do {} while (0)
+#endif
+
+
+struct SmlTraceEvent
+{
+    const char* name{ nullptr }; //string literal, only the pointer is kept
+    qint64 beginTicks{ 0 };
+    qint64 endTicks{ 0 };
+};
+
+//a sample of a counter track ("C" event), e.g. the hardware counters of a scope
+struct SmlTraceCounter
+{
+    inline static constexpr int SML_TRACE_COUNTER_VALUES = 4;
+
+    const char* name{ nullptr };
+    const char* const* keys{ nullptr }; //static array of SML_TRACE_COUNTER_VALUES names, nullptr ends it early
+    qint64 ticks{ 0 };
+    double values[SML_TRACE_COUNTER_VALUES]{};
+};
+
+//written by its own thread only, read by the exporter; a full buffer drops new zones
+class SmlTraceBuffer final
+{
+public:
+    inline static constexpr size_t SML_TRACE_CAPACITY = size_t(1) << 16;
+    inline static constexpr size_t SML_TRACE_COUNTER_CAPACITY = size_t(1) << 14;
+
+private:
+    friend class SmlTrace;
+
+    SmlTraceEvent _events[SML_TRACE_CAPACITY];
+    std::atomic<size_t> _count{ 0 };
+    SmlTraceCounter _counters[SML_TRACE_COUNTER_CAPACITY];
+    std::atomic<size_t> _counterCount{ 0 };
+    std::atomic<quint64> _dropped{ 0 };
+    quint64 _tid{ 0 };
+    QByteArray _threadName; //guarded by the registry mutex
+
+public:
+    void Push(const char* name, qint64 beginTicks, qint64 endTicks)
+    {
+        size_t count = _count.load(std::memory_order_relaxed);
+        if (count < SML_TRACE_CAPACITY)
+        {
+            _events[count] = SmlTraceEvent{ name, beginTicks, endTicks };
+            _count.store(count + 1, std::memory_order_release); //publishes the event to the exporter
+        }
+        else
+        {
+            _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    void PushCounter(const SmlTraceCounter& counter)
+    {
+        size_t count = _counterCount.load(std::memory_order_relaxed);
+        if (count < SML_TRACE_COUNTER_CAPACITY)
+        {
+            _counters[count] = counter;
+            _counterCount.store(count + 1, std::memory_order_release);
+        }
+        else
+        {
+            _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+};
+
+
+class SmlTrace final
+{
+private:
+    static SmlTraceBuffer* Register();
+
+public:
+    static qint64 NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //zones are stamped with the tsc where there is one, reading the clock twice per zone
+    //costs more than the whole budget; ticks are converted to ns on export
+    static qint64 NowTicks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return qint64(__rdtsc());
+#else
+        return NowNs();
+#endif
+    }
+
+    static SmlTraceBuffer* ThreadBuffer()
+    {
+        static thread_local SmlTraceBuffer* buffer = nullptr;
+        if (nullptr == buffer)
+        {
+            buffer = Register(); //first zone of this thread
+        }
+        return buffer;
+    }
+
+    //defaults to QThread::objectName() of the thread that records the first zone
+    static void SetThreadName(const char* name);
+
+    //any thread, zones still open are not part of the output
+    static bool WriteChromeJson(const QString& fileName);
+};
+
+
+class SmlTraceZone final
+{
+private:
+    const char* _name{ nullptr };
+    qint64 _beginTicks{ 0 };
+
+public:
+    explicit SmlTraceZone(const char* name) :
+        _name{ name },
+        _beginTicks{ SmlTrace::NowTicks() }
+    {
+    }
+
+    ~SmlTraceZone()
+    {
+        SmlTrace::ThreadBuffer()->Push(_name, _beginTicks, SmlTrace::NowTicks());
+    }
+
+    SmlTraceZone(const SmlTraceZone&) = delete;
+    SmlTraceZone& operator=(const SmlTraceZone&) = delete;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+
+//wait free single writer / single reader snapshot
+//the writer fills Back() and publishes it as a whole, the reader always gets the latest
+//published value; neither side ever blocks and a value is never torn
+template<typename T>
+class SmlTripleBuffer final
+{
+private:
+	inline static constexpr unsigned SML_INDEX_MASK = 3u;
+	inline static constexpr unsigned SML_FRESH = 4u; //middle slot holds a value the reader has not taken yet
+
+	T _slots[3]{};
+
+	alignas(64) std::atomic<unsigned> _middle{ 1 }; //index of the published slot | SML_FRESH
+	alignas(64) unsigned _back{ 0 }; //writer owned
+	alignas(64) unsigned _front{ 2 }; //reader owned
+
+public:
+	SmlTripleBuffer() = default;
+
+	explicit SmlTripleBuffer(const T& init)
+	{
+		_slots[0] = init;
+		_slots[1] = init;
+		_slots[2] = init;
+	}
+
+	SmlTripleBuffer(const SmlTripleBuffer&) = delete;
+	SmlTripleBuffer& operator=(const SmlTripleBuffer&) = delete;
+
+	/////////////////////////////////////////////////////////////////
+	//writer thread only
+	T& Back()
+	{
+		return _slots[_back];
+	}
+
+	void Publish()
+	{
+		unsigned prev = _middle.exchange(_back | SML_FRESH, std::memory_order_acq_rel);
+		_back = prev & SML_INDEX_MASK;
+	}
+
+	void Publish(const T& value)
+	{
+		_slots[_back] = value;
+		Publish();
+	}
+
+	/////////////////////////////////////////////////////////////////
+	//reader thread only
+	bool HasNew() const
+	{
+		return 0 != (_middle.load(std::memory_order_relaxed) & SML_FRESH);
+	}
+
+	const T& Read()
+	{
+		if (HasNew())
+		{
+			unsigned prev = _middle.exchange(_front, std::memory_order_acq_rel);
+			_front = prev & SML_INDEX_MASK;
+		}
+		return _slots[_front];
+	}
+};
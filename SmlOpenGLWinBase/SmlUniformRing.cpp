@@ -0,0 +1,80 @@
+#include "SmlUniformRing.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+bool SmlUniformRing::Create(QOpenGLFunctions_PROFILE* gl, GLsizeiptr bytesPerSlot, int slots)
+{
+    Destroy();
+
+    _gl = gl;
+    _gl->glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &_alignment);
+    _alignment = std::max(_alignment, 1);
+
+    //every slot starts aligned
+    _bytesPerSlot = (bytesPerSlot + _alignment - 1) / _alignment * _alignment;
+    _slots = std::max(slots, 1);
+    const GLsizeiptr total = _bytesPerSlot * _slots;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _gl->glCreateBuffers(1, &_buffer);
+    _gl->glNamedBufferStorage(_buffer, total, nullptr, flags);
+    _mapped = static_cast<unsigned char*>(_gl->glMapNamedBufferRange(_buffer, 0, total, flags));
+    if (nullptr == _mapped)
+    {
+        qWarning() << "SmlUniformRing: persistent mapping failed";
+        _gl->glDeleteBuffers(1, &_buffer);
+        _buffer = 0;
+        _gl = nullptr;
+        return false;
+    }
+
+    BeginFrame(0);
+    return true;
+}
+
+void SmlUniformRing::Destroy()
+{
+    if (_gl)
+    {
+        if (_mapped)
+        {
+            _gl->glUnmapNamedBuffer(_buffer);
+        }
+        _gl->glDeleteBuffers(1, &_buffer);
+    }
+
+    _gl = nullptr;
+    _buffer = 0;
+    _mapped = nullptr;
+    _offset = 0;
+    _slotEnd = 0;
+}
+
+void SmlUniformRing::BeginFrame(int slot)
+{
+    _offset = _bytesPerSlot * (slot % std::max(_slots, 1));
+    _slotEnd = _offset + _bytesPerSlot;
+}
+
+SmlUniformAlloc SmlUniformRing::Allocate(GLsizeiptr size)
+{
+    SmlUniformAlloc alloc;
+    if (nullptr == _mapped || _offset + size > _slotEnd)
+    {
+        if (_mapped && 0 == _overflows++)
+        {
+            qWarning() << "SmlUniformRing: frame slot of" << _bytesPerSlot << "bytes is full";
+        }
+        return alloc;
+    }
+
+    alloc.buffer = _buffer;
+    alloc.offset = _offset;
+    alloc.size = size;
+    alloc.data = _mapped + _offset;
+
+    _offset = (_offset + size + _alignment - 1) / _alignment * _alignment;
+    return alloc;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstring>
+#include <type_traits>
+
+#include "SmlGLFunctions.h"
+
+//a range of the ring written this frame, bind it with
+//glBindBufferRange(GL_UNIFORM_BUFFER, binding, alloc.buffer, alloc.offset, alloc.size)
+struct SmlUniformAlloc
+{
+    GLuint buffer{ 0 };
+    GLintptr offset{ 0 };
+    GLsizeiptr size{ 0 };
+    void* data{ nullptr }; //persistently mapped, coherent, nullptr when the frame ran out of space
+
+    bool IsValid() const { return nullptr != data; }
+};
+
+//uniform blocks of a frame are written straight into one persistently mapped buffer
+//(GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT), split in one region per frame slot;
+//the ring itself does not fence, BeginFrame must only be called for a slot the gpu is
+//done with, SmlGLWindow calls it after waiting the fence of the slot
+class SmlUniformRing final
+{
+private:
+    QOpenGLFunctions_PROFILE* _gl{ nullptr };
+    GLuint _buffer{ 0 };
+    unsigned char* _mapped{ nullptr };
+    GLsizeiptr _bytesPerSlot{ 0 };
+    int _slots{ 0 };
+    GLint _alignment{ 256 }; //GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+    GLsizeiptr _offset{ 0 };   //next free byte
+    GLsizeiptr _slotEnd{ 0 };
+    quint64 _overflows{ 0 };
+
+public:
+    SmlUniformRing() = default;
+    SmlUniformRing(const SmlUniformRing&) = delete;
+    SmlUniformRing& operator=(const SmlUniformRing&) = delete;
+
+    //render thread, ctx current
+    bool Create(QOpenGLFunctions_PROFILE* gl, GLsizeiptr bytesPerSlot, int slots);
+    void Destroy();
+    bool IsCreated() const { return nullptr != _mapped; }
+
+    void BeginFrame(int slot);
+
+    //aligned for glBindBufferRange, invalid once the slot is full
+    SmlUniformAlloc Allocate(GLsizeiptr size);
+
+    template<typename TBlock>
+    SmlUniformAlloc Push(const TBlock& block)
+    {
+        static_assert(std::is_trivially_copyable_v<TBlock>, "uniform blocks are copied as bytes");
+        SmlUniformAlloc alloc = Allocate(sizeof(TBlock));
+        if (alloc.IsValid())
+        {
+            memcpy(alloc.data, &block, sizeof(TBlock));
+        }
+        return alloc;
+    }
+
+    GLsizeiptr UsedThisFrame() const { return _offset - (_slotEnd - _bytesPerSlot); }
+    quint64 Overflows() const { return _overflows; }
+};
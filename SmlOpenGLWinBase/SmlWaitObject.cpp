@@ -4,17 +4,168 @@
 #include <QWaitCondition>
 #include <QMutex>
 
+#include "SmlTrace.h"
 
-SmlEvent::SmlEvent(bool busy) :
+#include <QDebug>
+#include <chrono>
+#include <algorithm>
+
+#if SML_FUTEX_WAIT_OBJECT
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <climits>
+#endif
+
+
+/////////////////////////////////////////////////////////////////
+struct SmlWaitStatsRegistry
+{
+	QMutex mutex;
+	std::vector<SmlWaitStats*> live;
+	std::vector<SmlWaitStatsSnapshot> retired;
+};
+
+static SmlWaitStatsRegistry& SmlStatsRegistry()
+{
+	static SmlWaitStatsRegistry registry;
+	return registry;
+}
+
+qint64 SmlWaitStats::NowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SmlWaitStats::SmlWaitStats(const QByteArray& name) :
+	_name{ name }
+{
+	SmlWaitStatsRegistry& registry = SmlStatsRegistry();
+	QMutexLocker<QMutex> locker{ &registry.mutex };
+	registry.live.push_back(this);
+}
+
+SmlWaitStats::~SmlWaitStats()
+{
+	SmlWaitStatsSnapshot snapshot = Snapshot();
+
+	SmlWaitStatsRegistry& registry = SmlStatsRegistry();
+	QMutexLocker<QMutex> locker{ &registry.mutex };
+	registry.live.erase(std::remove(registry.live.begin(), registry.live.end(), this), registry.live.end());
+	if (snapshot.acquisitions || snapshot.timeouts)
+	{
+		registry.retired.push_back(snapshot);
+	}
+}
+
+void SmlWaitStats::RecordUncontended()
+{
+	_acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SmlWaitStats::RecordContended(bool acquired, qint64 waitNs)
+{
+	(acquired ? _acquisitions : _timeouts).fetch_add(1, std::memory_order_relaxed);
+	_contended.fetch_add(1, std::memory_order_relaxed);
+
+	quint64 ns = quint64(std::max<qint64>(waitNs, 1));
+	int bucket = std::min(63 - __builtin_clzll(ns), SML_WAIT_BUCKETS - 1);
+	_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	quint64 maxNs = _maxWaitNs.load(std::memory_order_relaxed);
+	while (ns > maxNs && !_maxWaitNs.compare_exchange_weak(maxNs, ns, std::memory_order_relaxed))
+	{
+	}
+}
+
+SmlWaitStatsSnapshot SmlWaitStats::Snapshot() const
+{
+	SmlWaitStatsSnapshot snapshot;
+	snapshot.name = _name;
+	snapshot.acquisitions = _acquisitions.load(std::memory_order_relaxed);
+	snapshot.contended = _contended.load(std::memory_order_relaxed);
+	snapshot.timeouts = _timeouts.load(std::memory_order_relaxed);
+	snapshot.maxWaitMs = _maxWaitNs.load(std::memory_order_relaxed) / 1e6;
+
+	quint64 counts[SML_WAIT_BUCKETS];
+	quint64 total = 0;
+	for (int ii = 0; ii < SML_WAIT_BUCKETS; ++ii)
+	{
+		counts[ii] = _buckets[ii].load(std::memory_order_relaxed);
+		total += counts[ii];
+	}
+
+	auto percentile = [&counts, total](double ratio) -> double
+	{
+		quint64 rank = quint64(ratio * total);
+		quint64 seen = 0;
+		for (int ii = 0; ii < SML_WAIT_BUCKETS; ++ii)
+		{
+			seen += counts[ii];
+			if (seen > rank)
+			{
+				return double(2ull << ii) / 1e6; //upper bound of [2^ii, 2^(ii+1))
+			}
+		}
+		return 0;
+	};
+
+	if (total)
+	{
+		snapshot.p50WaitMs = percentile(0.50);
+		snapshot.p95WaitMs = percentile(0.95);
+		snapshot.p99WaitMs = percentile(0.99);
+	}
+	return snapshot;
+}
+
+std::vector<SmlWaitStatsSnapshot> SmlWaitStats::All()
+{
+	SmlWaitStatsRegistry& registry = SmlStatsRegistry();
+	QMutexLocker<QMutex> locker{ &registry.mutex };
+
+	std::vector<SmlWaitStatsSnapshot> all = registry.retired;
+	for (const SmlWaitStats* stats : registry.live)
+	{
+		all.push_back(stats->Snapshot());
+	}
+	return all;
+}
+
+void SmlWaitStats::DumpAll()
+{
+	for (const SmlWaitStatsSnapshot& stats : All())
+	{
+		qDebug().nospace() << stats.name.constData()
+			<< ": acquisitions " << stats.acquisitions
+			<< " contended " << stats.contended
+			<< " timeouts " << stats.timeouts
+			<< " wait ms p50 " << stats.p50WaitMs
+			<< " p95 " << stats.p95WaitMs
+			<< " p99 " << stats.p99WaitMs
+			<< " max " << stats.maxWaitMs;
+	}
+}
+
+/////////////////////////////////////////////////////////////////
+SmlEventQt::SmlEventQt(bool busy) :
 	_busy(busy)
 {
 
 }
 
-bool SmlEvent::Wait(uint timeout)
+bool SmlEventQt::Wait(uint timeout)
 {
+	SML_TRACE_ZONE("SmlEvent::Wait");
+
 	bool waitok = true;
 	QMutexLocker<QMutex> locker{&_mutex};
+	const bool contended = _busy;
+	SmlWaitStats* stats = _stats.load(std::memory_order_acquire);
+	const qint64 beginNs = stats && contended ? SmlWaitStats::NowNs() : 0;
 	while (_busy)
 	{
 		waitok = _cond.wait(&_mutex, timeout);
@@ -30,10 +181,15 @@ bool SmlEvent::Wait(uint timeout)
 	}
 
 	locker.unlock();
+
+	if (stats)
+	{
+		contended ? stats->RecordContended(waitok, SmlWaitStats::NowNs() - beginNs) : stats->RecordUncontended();
+	}
 	return waitok;
 }
 
-void SmlEvent::Notify(bool all)
+void SmlEventQt::Notify(bool all)
 {
 	QMutexLocker<QMutex> locker{ &_mutex };
 	_busy = false;
@@ -50,17 +206,22 @@ void SmlEvent::Notify(bool all)
 	
 }
 
-SmlSemphore::SmlSemphore(int counter) :
+SmlSemphoreQt::SmlSemphoreQt(int counter) :
 	_couter{counter}
 {
 
 }
 
-bool SmlSemphore::Wait(uint timeout)
+bool SmlSemphoreQt::Wait(uint timeout)
 {
+	SML_TRACE_ZONE("SmlSemphore::Wait");
+
 	bool waitok = true;
 
 	QMutexLocker<QMutex> locker{ &_mutex };
+	const bool contended = (_couter == 0);
+	SmlWaitStats* stats = _stats.load(std::memory_order_acquire);
+	const qint64 beginNs = stats && contended ? SmlWaitStats::NowNs() : 0;
 	while (_couter == 0)
 	{
 		waitok = _cond.wait(&_mutex, timeout);
@@ -76,10 +237,15 @@ bool SmlSemphore::Wait(uint timeout)
 	}
 
 	locker.unlock();
+
+	if (stats)
+	{
+		contended ? stats->RecordContended(waitok, SmlWaitStats::NowNs() - beginNs) : stats->RecordUncontended();
+	}
 	return waitok;
 }
 
-void SmlSemphore::Notify(bool all)
+void SmlSemphoreQt::Notify(bool all)
 {
 	QMutexLocker<QMutex> locker{ &_mutex };
 	++_couter;
@@ -95,3 +261,229 @@ void SmlSemphore::Notify(bool all)
 	}
 
 }
+
+
+#if SML_FUTEX_WAIT_OBJECT
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex word must be a plain int");
+
+static int* SmlFutexWord(std::atomic<int>& word)
+{
+	return reinterpret_cast<int*>(&word);
+}
+
+//returns false on timeout
+static bool SmlFutexWait(std::atomic<int>& word, int expected, const struct timespec* deadline)
+{
+	struct timespec relative;
+	struct timespec* relativePtr = nullptr;
+	if (deadline)
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long long ns = (deadline->tv_sec - now.tv_sec) * 1000000000ll + (deadline->tv_nsec - now.tv_nsec);
+		if (ns <= 0)
+		{
+			return false;
+		}
+		relative.tv_sec = ns / 1000000000ll;
+		relative.tv_nsec = ns % 1000000000ll;
+		relativePtr = &relative;
+	}
+
+	long rc = syscall(SYS_futex, SmlFutexWord(word), FUTEX_WAIT_PRIVATE, expected, relativePtr, nullptr, 0);
+	return !(rc == -1 && errno == ETIMEDOUT);
+}
+
+static void SmlFutexWake(std::atomic<int>& word, bool all)
+{
+	syscall(SYS_futex, SmlFutexWord(word), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+}
+
+static const struct timespec* SmlDeadline(uint timeout, struct timespec& deadline)
+{
+	if (UINT_MAX == timeout)
+	{
+		return nullptr; //infinite
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout / 1000;
+	deadline.tv_nsec += (timeout % 1000) * 1000000l;
+	if (deadline.tv_nsec >= 1000000000l)
+	{
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000l;
+	}
+	return &deadline;
+}
+
+void SmlSpinAdapter::Pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+/////////////////////////////////////////////////////////////////
+SmlEventFutex::SmlEventFutex(bool busy) :
+	_busy{ busy ? 1 : 0 }
+{
+
+}
+
+bool SmlEventFutex::TryAcquire()
+{
+	int expected = 0;
+	return _busy.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+}
+
+bool SmlEventFutex::Wait(uint timeout)
+{
+	SmlWaitStats* stats = _stats.load(std::memory_order_acquire);
+	if (TryAcquire())
+	{
+		if (stats)
+		{
+			stats->RecordUncontended();
+		}
+		return true; //fast path, no syscall
+	}
+
+	if (nullptr == stats)
+	{
+		return WaitContended(timeout);
+	}
+
+	qint64 beginNs = SmlWaitStats::NowNs();
+	bool waitok = WaitContended(timeout);
+	stats->RecordContended(waitok, SmlWaitStats::NowNs() - beginNs);
+	return waitok;
+}
+
+bool SmlEventFutex::WaitContended(uint timeout)
+{
+	if (0 == timeout)
+	{
+		return false;
+	}
+
+	if (_spin.Spin([this] { return TryAcquire(); }))
+	{
+		return true;
+	}
+
+	struct timespec deadlineStorage;
+	const struct timespec* deadline = SmlDeadline(timeout, deadlineStorage);
+
+	SML_TRACE_ZONE("SmlEvent::Park"); //fast path and spin are not traced, they are too short to matter
+
+	bool waitok = true;
+	_waiters.fetch_add(1);
+	while (!TryAcquire())
+	{
+		if (!SmlFutexWait(_busy, 1, deadline))
+		{
+			waitok = TryAcquire(); //last chance, a Notify may have raced the timeout
+			break;
+		}
+	}
+	_waiters.fetch_sub(1);
+
+	return waitok;
+}
+
+void SmlEventFutex::Notify(bool all)
+{
+	_busy.store(0);
+	if (_waiters.load() > 0)
+	{
+		SmlFutexWake(_busy, all);
+	}
+}
+
+/////////////////////////////////////////////////////////////////
+SmlSemphoreFutex::SmlSemphoreFutex(int counter) :
+	_couter{ counter }
+{
+
+}
+
+bool SmlSemphoreFutex::TryAcquire()
+{
+	int counter = _couter.load(std::memory_order_relaxed);
+	while (counter > 0)
+	{
+		if (_couter.compare_exchange_weak(counter, counter - 1, std::memory_order_acquire))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SmlSemphoreFutex::Wait(uint timeout)
+{
+	SmlWaitStats* stats = _stats.load(std::memory_order_acquire);
+	if (TryAcquire())
+	{
+		if (stats)
+		{
+			stats->RecordUncontended();
+		}
+		return true; //fast path, no syscall
+	}
+
+	if (nullptr == stats)
+	{
+		return WaitContended(timeout);
+	}
+
+	qint64 beginNs = SmlWaitStats::NowNs();
+	bool waitok = WaitContended(timeout);
+	stats->RecordContended(waitok, SmlWaitStats::NowNs() - beginNs);
+	return waitok;
+}
+
+bool SmlSemphoreFutex::WaitContended(uint timeout)
+{
+	if (0 == timeout)
+	{
+		return false;
+	}
+
+	if (_spin.Spin([this] { return TryAcquire(); }))
+	{
+		return true;
+	}
+
+	struct timespec deadlineStorage;
+	const struct timespec* deadline = SmlDeadline(timeout, deadlineStorage);
+
+	SML_TRACE_ZONE("SmlSemphore::Park");
+
+	bool waitok = true;
+	_waiters.fetch_add(1);
+	while (!TryAcquire())
+	{
+		if (!SmlFutexWait(_couter, 0, deadline))
+		{
+			waitok = TryAcquire();
+			break;
+		}
+	}
+	_waiters.fetch_sub(1);
+
+	return waitok;
+}
+
+void SmlSemphoreFutex::Notify(bool all)
+{
+	_couter.fetch_add(1);
+	if (_waiters.load() > 0)
+	{
+		SmlFutexWake(_couter, all);
+	}
+}
+#endif
@@ -4,34 +4,177 @@
 #include <QWaitCondition>
 #include <QMutex>
 
-class SmlEvent final
+#include <QByteArray>
+
+#include <atomic>
+#include <vector>
+
+//on linux SmlEvent and SmlSemphore are built on atomics and futex, an uncontended
+//Wait/Notify never enters the kernel; elsewhere they fall back to QMutex + QWaitCondition
+#if defined(__linux__)
+#define SML_FUTEX_WAIT_OBJECT 1
+#else
+#define SML_FUTEX_WAIT_OBJECT 0
+#endif
+
+struct SmlWaitStatsSnapshot
+{
+	QByteArray name;
+	quint64 acquisitions{ 0 };  //successful waits
+	quint64 contended{ 0 };     //waits that could not acquire right away
+	quint64 timeouts{ 0 };
+	double maxWaitMs{ 0 };      //contended waits only, timeouts included
+	double p50WaitMs{ 0 };
+	double p95WaitMs{ 0 };
+	double p99WaitMs{ 0 };
+};
+
+//optional per instance counters of a wait object, attached with SetStats
+//wait times go into log2 ns buckets, percentiles are the upper bound of their bucket;
+//every instance is listed in a registry that outlives it, so DumpAll at exit
+//also reports wait objects that are already gone
+class SmlWaitStats final
+{
+private:
+	inline static constexpr int SML_WAIT_BUCKETS = 40; //2^40 ns is about 18 minutes
+
+	QByteArray _name;
+	std::atomic<quint64> _acquisitions{ 0 };
+	std::atomic<quint64> _contended{ 0 };
+	std::atomic<quint64> _timeouts{ 0 };
+	std::atomic<quint64> _maxWaitNs{ 0 };
+	std::atomic<quint64> _buckets[SML_WAIT_BUCKETS]{};
+
+public:
+	static qint64 NowNs();
+
+	SmlWaitStats(const QByteArray& name);
+	~SmlWaitStats();
+
+	SmlWaitStats(const SmlWaitStats&) = delete;
+	SmlWaitStats& operator=(const SmlWaitStats&) = delete;
+
+	void RecordUncontended();
+	void RecordContended(bool acquired, qint64 waitNs);
+
+	SmlWaitStatsSnapshot Snapshot() const;
+
+	//live and retired instances
+	static std::vector<SmlWaitStatsSnapshot> All();
+	static void DumpAll();
+};
+
+
+class SmlEventQt final
 {
 private:
 	volatile bool _busy{ false };
 	QMutex _mutex;
 	QWaitCondition _cond;
+	std::atomic<SmlWaitStats*> _stats{ nullptr };
 
 public:
-	SmlEvent(bool busy);
+	SmlEventQt(bool busy);
 	bool Wait(uint timeout);
 	void Notify(bool all);
+	void SetStats(SmlWaitStats* stats) { _stats.store(stats, std::memory_order_release); }
 };
 
 
-class SmlSemphore final
+class SmlSemphoreQt final
 {
 private:
 	volatile int _couter{ 0 };
 	QMutex _mutex;
 	QWaitCondition _cond;
+	std::atomic<SmlWaitStats*> _stats{ nullptr };
+
+public:
+	SmlSemphoreQt(int counter);
+	bool Wait(uint timeout);
+	void Notify(bool all);
+	void SetStats(SmlWaitStats* stats) { _stats.store(stats, std::memory_order_release); }
+};
+
+
+#if SML_FUTEX_WAIT_OBJECT
+//spin a while before parking, the spin length adapts to how often spinning pays off
+class SmlSpinAdapter final
+{
+private:
+	inline static constexpr int SML_SPIN_MIN = 16;
+	inline static constexpr int SML_SPIN_MAX = 4096;
+	std::atomic<int> _spinLimit{ 128 };
 
 public:
-	SmlSemphore(int counter);
+	template<typename TRY>
+	bool Spin(TRY tryAcquire)
+	{
+		int limit = _spinLimit.load(std::memory_order_relaxed);
+		for (int ii = 0; ii < limit; ++ii)
+		{
+			if (tryAcquire())
+			{
+				_spinLimit.store(qMin(limit * 2, SML_SPIN_MAX), std::memory_order_relaxed);
+				return true;
+			}
+			Pause();
+		}
+		_spinLimit.store(qMax(limit / 2, SML_SPIN_MIN), std::memory_order_relaxed);
+		return false;
+	}
+
+	static void Pause();
+};
+
+
+class SmlEventFutex final
+{
+private:
+	std::atomic<int> _busy{ 1 }; //futex word, 0 means signaled
+	std::atomic<int> _waiters{ 0 };
+	SmlSpinAdapter _spin;
+	std::atomic<SmlWaitStats*> _stats{ nullptr };
+
+private:
+	bool TryAcquire();
+	bool WaitContended(uint timeout);
+
+public:
+	SmlEventFutex(bool busy);
 	bool Wait(uint timeout);
 	void Notify(bool all);
+	void SetStats(SmlWaitStats* stats) { _stats.store(stats, std::memory_order_release); }
 };
 
 
+class SmlSemphoreFutex final
+{
+private:
+	std::atomic<int> _couter{ 0 }; //futex word
+	std::atomic<int> _waiters{ 0 };
+	SmlSpinAdapter _spin;
+	std::atomic<SmlWaitStats*> _stats{ nullptr };
+
+private:
+	bool TryAcquire();
+	bool WaitContended(uint timeout);
+
+public:
+	SmlSemphoreFutex(int counter);
+	bool Wait(uint timeout);
+	void Notify(bool all);
+	void SetStats(SmlWaitStats* stats) { _stats.store(stats, std::memory_order_release); }
+};
+
+using SmlEvent = SmlEventFutex;
+using SmlSemphore = SmlSemphoreFutex;
+#else
+using SmlEvent = SmlEventQt;
+using SmlSemphore = SmlSemphoreQt;
+#endif
+
+
 template<typename TMUTEX>
 class SmlMTLocker
 {
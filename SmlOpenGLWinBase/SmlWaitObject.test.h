@@ -0,0 +1,100 @@
+#pragma once
+
+#include <semaphore>
+#include <thread>
+#include <climits>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include "SmlWaitObject.h"
+
+class SmlWaitObjectTest
+{
+private:
+    //same Wait/Notify shape as the Sml wait objects
+    class StdSemphore
+    {
+    private:
+        std::counting_semaphore<INT_MAX> _sem;
+
+    public:
+        StdSemphore(int counter) : _sem{ counter } {}
+
+        bool Wait(uint timeout)
+        {
+            if (UINT_MAX == timeout)
+            {
+                _sem.acquire();
+                return true;
+            }
+            return _sem.try_acquire_for(std::chrono::milliseconds(timeout));
+        }
+
+        void Notify(bool /*all*/)
+        {
+            _sem.release();
+        }
+    };
+
+    //Notify then Wait on one thread, nobody ever waits
+    template<typename SEM>
+    static double Uncontended(int loopCount)
+    {
+        SEM sem{ 0 };
+        QElapsedTimer timer;
+        timer.start();
+        for (int ii = 0; ii < loopCount; ++ii)
+        {
+            sem.Notify(false);
+            sem.Wait(UINT_MAX);
+        }
+        return double(timer.nsecsElapsed()) / loopCount;
+    }
+
+    //two threads hand a token back and forth, one round trip per loop
+    template<typename SEM>
+    static double PingPong(int loopCount)
+    {
+        SEM ping{ 0 };
+        SEM pong{ 0 };
+
+        std::thread peer{ [&]()
+        {
+            for (int ii = 0; ii < loopCount; ++ii)
+            {
+                ping.Wait(UINT_MAX);
+                pong.Notify(false);
+            }
+        } };
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int ii = 0; ii < loopCount; ++ii)
+        {
+            ping.Notify(false);
+            pong.Wait(UINT_MAX);
+        }
+        double ns = double(timer.nsecsElapsed()) / loopCount;
+
+        peer.join();
+        return ns;
+    }
+
+    template<typename SEM>
+    static void Report(const char* name)
+    {
+        const int uncontendedCount = 1000000;
+        const int pingPongCount = 100000;
+        qDebug() << name
+                 << "uncontended ns/op:" << Uncontended<SEM>(uncontendedCount)
+                 << "ping-pong ns/round trip:" << PingPong<SEM>(pingPongCount);
+    }
+
+public:
+    static void Case0_WaitObjectBench()
+    {
+        Report<SmlSemphoreQt>("SmlSemphoreQt (QMutex + QWaitCondition)");
+        Report<SmlSemphore>(SML_FUTEX_WAIT_OBJECT ? "SmlSemphore (futex)" : "SmlSemphore");
+        Report<StdSemphore>("std::counting_semaphore");
+    }
+};
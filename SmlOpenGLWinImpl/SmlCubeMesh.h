@@ -0,0 +1,55 @@
+#pragma once
+
+#include "SmlGLFunctions.h"
+
+//the box every sample window draws, 8 corners and 6 quads split into triangles
+inline const GLfloat oglpos[] =
+{
+		-1, -1, 0, 1,
+		+1, -1, 0, 1,
+		+1, +1, 0, 1,
+		-1, +1, 0, 1,
+
+		-1, -1, -6, 1,
+		+1, -1, -6, 1,
+		+1, +1, -6, 1,
+		-1, +1, -6, 1,
+};
+
+inline const GLfloat oglcolor[] =
+{
+	1,0,0,1,
+	0,1,0,1,
+	0,0,1,0,
+	1,1,1,1,
+
+	1,0,0,1,
+	0,1,0,1,
+	0,0,1,0,
+	1,1,1,1,
+};
+
+inline const GLfloat texCoords[] =
+{
+	0, 0,
+	1, 0,
+	1, 1,
+	0, 1,
+
+	0, 0,
+	1, 0,
+	1, 1,
+	0, 1,
+};
+
+
+#define QURAD_TO_TRIANGLE(p0, p1, p2, p3)  p0, p1, p2, p2, p3, p0
+
+inline const GLuint oglindics[] = {
+	QURAD_TO_TRIANGLE(0,1,2,3),
+	QURAD_TO_TRIANGLE(1,5,6,2),
+	QURAD_TO_TRIANGLE(5,4,7,6),
+	QURAD_TO_TRIANGLE(4,0,3,7),
+	QURAD_TO_TRIANGLE(3,2,6,7),
+	QURAD_TO_TRIANGLE(4,5,1,0),
+};
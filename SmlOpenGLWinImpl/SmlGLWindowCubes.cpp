@@ -0,0 +1,212 @@
+#include "SmlGLWindowCubes.h"
+
+#include <QFile>
+#include <QColor>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/ext/matrix_transform.hpp> // glm::lookAt
+#include <glm/ext/matrix_clip_space.hpp> // glm::perspective
+#include <glm/gtc/type_ptr.hpp>
+
+#include "SmlTrace.h"
+#include "SmlCubeMesh.h"
+
+
+/////////////////////////////////////////////////////////////////
+static constexpr float CUBE_CELL = 8.0f; //grid spacing, the box is 2 x 2 x 6
+
+
+SmlGLProgramTicket SmlGLWindowCubes::LoadProgram()
+{
+	QFile filevert{ ":/shaders/shader/cubes.vert" };
+	filevert.open(QFile::ReadOnly);
+	QByteArray vertBuffer = filevert.readAll();
+	filevert.close();
+
+	QFile filefrag{ ":/shaders/shader/cubes.frag" };
+	filefrag.open(QFile::ReadOnly);
+	QByteArray fragBuffer = filefrag.readAll();
+	filefrag.close();
+
+	return CreateProgramAsync(vertBuffer.data(), nullptr, fragBuffer.data());
+}
+
+void SmlGLWindowCubes::CreateInstances()
+{
+	//smallest cube grid that holds cubeCount, centered on the origin
+	const int count = std::max(_scene.cubeCount, 1);
+	const int side = int(std::ceil(std::cbrt(double(count))));
+	const float half = (side - 1) * 0.5f;
+	_gridExtent = side * CUBE_CELL;
+
+	std::vector<glm::vec4> offsets;
+	offsets.reserve(count);
+	for (int ii = 0; ii < count; ++ii)
+	{
+		int x = ii % side;
+		int y = (ii / side) % side;
+		int z = ii / (side * side);
+		offsets.emplace_back((x - half) * CUBE_CELL, (y - half) * CUBE_CELL, (z - half) * CUBE_CELL + 3.0f, 1.0f);
+	}
+
+	glCreateBuffers(1, &_vboInstance);
+	glNamedBufferStorage(_vboInstance, GLsizeiptr(offsets.size() * sizeof(glm::vec4)), offsets.data(), 0);
+}
+
+void SmlGLWindowCubes::CreateTexture()
+{
+	//checker board, generated so any size can be asked for
+	const int size = std::max(_scene.textureSize, 1);
+	std::vector<quint32> pixels(size_t(size) * size);
+	const int square = std::max(size / 8, 1);
+	for (int yy = 0; yy < size; ++yy)
+	{
+		for (int xx = 0; xx < size; ++xx)
+		{
+			bool light = ((xx / square) + (yy / square)) % 2;
+			pixels[size_t(yy) * size + xx] = light ? 0xffe0e0e0u : 0xff303030u;
+		}
+	}
+
+	int levels = 1;
+	while ((size >> levels) > 0)
+	{
+		++levels;
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &_texture);
+	glTextureParameteri(_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(_texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(_texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureStorage2D(_texture, levels, GL_RGBA8, size, size);
+	glTextureSubImage2D(_texture, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glGenerateTextureMipmap(_texture);
+}
+
+void SmlGLWindowCubes::GLInitialize()
+{
+	SML_TRACE_ZONE("SmlGLWindowCubes::GLInitialize");
+
+	//the driver compiles while the buffers, instances and texture below are created
+	SmlGLProgramTicket programTicket = LoadProgram();
+
+	/////////////////////////////////////////////////////////////////
+	glCreateBuffers(1, &_vboPos);
+	glCreateBuffers(1, &_vboColor);
+	glCreateBuffers(1, &_vboTextCoord);
+	glCreateBuffers(1, &_vboElemet);
+
+	glNamedBufferData(_vboPos, sizeof(oglpos), oglpos, GL_STATIC_DRAW);
+	glNamedBufferData(_vboColor, sizeof(oglcolor), oglcolor, GL_STATIC_DRAW);
+	glNamedBufferData(_vboTextCoord, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
+	glNamedBufferData(_vboElemet, sizeof(oglindics), oglindics, GL_STATIC_DRAW);
+
+	CreateInstances();
+	CreateTexture();
+
+	/////////////////////////////////////////////////////////////////
+	_program = WaitProgram(programTicket); //first use, the vao needs the attribute locations
+	_viewProj = _program.Uniform<glm::mat4>("viewProj");
+	_texSampler = _program.Uniform<SmlGLSampler>("tex");
+	_posAttrib = _program.Attribute("pos");
+	_colorAttrib = _program.Attribute("color");
+	_texCoordAttrib = _program.Attribute("textCoord");
+	_instanceAttrib = _program.Attribute("instanceOffset");
+
+	glCreateVertexArrays(1, &_vao);
+
+	SetVertexAttribute(_vao, _posAttrib, 4, GL_FLOAT, _vboPos, sizeof(GLfloat) * 4);
+	SetVertexAttribute(_vao, _colorAttrib, 4, GL_FLOAT, _vboColor, sizeof(GLfloat) * 4);
+	SetVertexAttribute(_vao, _texCoordAttrib, 2, GL_FLOAT, _vboTextCoord, sizeof(GLfloat) * 2);
+	SetVertexAttribute(_vao, _instanceAttrib, 4, GL_FLOAT, _vboInstance, sizeof(GLfloat) * 4, 1); //one offset per cube
+	glVertexArrayElementBuffer(_vao, _vboElemet);
+
+	/////////////////////////////////////////////////////////////////
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+}
+
+void SmlGLWindowCubes::GLResize(const QSize& size, const QSize& oldSize)
+{
+	glViewport(0, 0, size.width(), size.height());
+
+	float aspect = float(size.width()) / float(std::max(size.height(), 1));
+	_projection = glm::perspective(glm::radians(60.0f), aspect, 1.0f, _gridExtent * 4.0f + 100.0f);
+}
+
+void SmlGLWindowCubes::GLPaint(QPaintDevice* paintDev)
+{
+	SML_TRACE_ZONE("SmlGLWindowCubes::GLPaint");
+
+	QColor bgcolor = Qt::darkCyan;
+	glClearColor(bgcolor.redF(), bgcolor.greenF(), bgcolor.blueF(), 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+	//orbit by frame count, not by time, so every run sees the same sequence of views
+	float radians = glm::radians(0.5f * float(_frameCounter++));
+	float distance = _gridExtent * 1.5f + 20.0f;
+	glm::vec3 eye{ distance * std::sin(radians), distance * 0.3f, distance * std::cos(radians) };
+	glm::mat4 viewProj = _projection * glm::lookAt(eye, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+
+	const int texUnit = 0;
+	glUseProgram(_program.Id());
+	SetUniform(_viewProj, viewProj);
+	SetUniform(_texSampler, SmlGLSampler{ texUnit });
+	glBindTextureUnit(texUnit, _texture);
+	glBindVertexArray(_vao);
+
+	glDrawElementsInstanced(GL_TRIANGLES, sizeof(oglindics) / sizeof(oglindics[0]), GL_UNSIGNED_INT, nullptr,
+		std::max(_scene.cubeCount, 1));
+
+	glBindVertexArray(0);
+	glBindTextureUnit(texUnit, 0);
+	glUseProgram(0);
+}
+
+void SmlGLWindowCubes::GLFinalize()
+{
+	GLuint buffers[] = { _vboPos, _vboColor, _vboTextCoord, _vboElemet, _vboInstance };
+	for (GLuint& buffer : buffers)
+	{
+		if (buffer != -1)
+		{
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+	_vboPos = _vboColor = _vboTextCoord = _vboElemet = _vboInstance = -1;
+
+	if (_texture != -1)
+	{
+		glDeleteTextures(1, &_texture);
+		_texture = -1;
+	}
+
+	if (_vao != -1)
+	{
+		glDeleteVertexArrays(1, &_vao);
+		_vao = -1;
+	}
+
+	if (_program.Id())
+	{
+		glDeleteProgram(_program.Id());
+		_program = SmlGLProgram{};
+	}
+}
+
+SmlGLWindowCubes::SmlGLWindowCubes(QWindow* parent, const SmlCubeScene& scene, bool requestMode /*= false*/, bool multiThreadMode /*= true*/, bool ctxOwnerMode /*= false*/)
+	: XQTBase(parent, requestMode, multiThreadMode, ctxOwnerMode),
+	_scene{ scene }
+{
+	EnableProgramCache();
+}
+
+SmlGLWindowCubes::~SmlGLWindowCubes()
+{
+	destroy(); //surface event, GLFinalize runs while this part is still alive
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QObject>
+#include "SmlGLWindow.h"
+
+#include <glm/glm.hpp>
+
+//what SmlGLWindowCubes draws, scaled by the render benchmark presets
+struct SmlCubeScene
+{
+	int cubeCount{ 1 };      //instances of the cube mesh on a 3d grid
+	int textureSize{ 256 };  //square checker texture, mipmapped
+};
+
+
+//draws SmlCubeScene::cubeCount boxes with one instanced draw call
+class SmlGLWindowCubes : public SmlGLWindow
+{
+	Q_OBJECT
+
+private:
+	using XQTBase = SmlGLWindow;
+
+private:
+	SmlCubeScene _scene;
+
+	SmlGLProgram _program;
+	GLuint _vao{ GLuint(-1) };
+
+	GLuint _vboPos{ GLuint(-1) };
+	GLuint _vboColor{ GLuint(-1) };
+	GLuint _vboTextCoord{ GLuint(-1) };
+	GLuint _vboElemet{ GLuint(-1) };
+	GLuint _vboInstance{ GLuint(-1) };
+
+	GLuint _texture{ GLuint(-1) };
+
+	//resolved from _program at link time
+	SmlGLUniform<glm::mat4> _viewProj;
+	SmlGLUniform<SmlGLSampler> _texSampler;
+	SmlGLAttribute _posAttrib;
+	SmlGLAttribute _colorAttrib;
+	SmlGLAttribute _texCoordAttrib;
+	SmlGLAttribute _instanceAttrib;
+
+	glm::mat4 _projection{ 1.0f };
+	float _gridExtent{ 0 };
+	quint64 _frameCounter{ 0 };
+
+private:
+	virtual void GLInitialize() override;
+	virtual void GLResize(const QSize& size, const QSize& oldSize) override;
+	virtual void GLPaint(QPaintDevice* paintDev) override;
+	virtual void GLFinalize() override;
+
+private:
+	SmlGLProgramTicket LoadProgram();
+	void CreateInstances();
+	void CreateTexture();
+
+public:
+	SmlGLWindowCubes(QWindow *parent, const SmlCubeScene& scene, bool requestMode = false, bool multiThreadMode = true, bool ctxOwnerMode = false);
+	virtual ~SmlGLWindowCubes() override;
+
+	const SmlCubeScene& Scene() const { return _scene; }
+};
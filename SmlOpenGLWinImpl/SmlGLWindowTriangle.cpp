@@ -5,6 +5,11 @@
 #include <QFile>
 #include <QTimer>
 #include <QKeyEvent>
+#include <QImage>
+#include <QDebug>
+
+#include <memory>
+#include <cstdio>
 
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale
@@ -14,6 +19,10 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "Sml3DMath/SmlGlmUtils.h"
+#include "SmlTrace.h"
+#include "SmlAllocTracker.h"
+#include "SmlPerfCounters.h"
+#include "SmlCubeMesh.h"
 
 /////////////////////////////////////////////////////////////////
 inline static constexpr float _logicalHeightUnit = (float)(8.0f);
@@ -25,58 +34,6 @@ inline static constexpr float _logicalHeightUnit = (float)(8.0f);
 static constexpr float DISTANCE_POINT = -5.0f;
 
 
-static GLfloat oglpos[] =
-{
-		-1, -1, 0, 1,
-		+1, -1, 0, 1,
-		+1, +1, 0, 1,
-		-1, +1, 0, 1,
-
-		-1, -1, -6, 1,
-		+1, -1, -6, 1,
-		+1, +1, -6, 1,
-		-1, +1, -6, 1,
-};
-
-static GLfloat oglcolor[] =
-{
-	1,0,0,1,
-	0,1,0,1,
-	0,0,1,0,
-	1,1,1,1,
-
-	1,0,0,1,
-	0,1,0,1,
-	0,0,1,0,
-	1,1,1,1,
-};
-
-static GLfloat texCoords[] =
-{
-	0, 0,
-	1, 0,
-	1, 1,
-	0, 1,
-
-	0, 0,
-	1, 0,
-	1, 1,
-	0, 1,
-};
-
-
-#define QURAD_TO_TRIANGLE(p0, p1, p2, p3)  p0, p1, p2, p2, p3, p0
-
-static GLuint oglindics[] = {
-	QURAD_TO_TRIANGLE(0,1,2,3),
-	QURAD_TO_TRIANGLE(1,5,6,2),
-	QURAD_TO_TRIANGLE(5,4,7,6),
-	QURAD_TO_TRIANGLE(4,0,3,7),
-	QURAD_TO_TRIANGLE(3,2,6,7),
-	QURAD_TO_TRIANGLE(4,5,1,0),
-};
-
-
 //static GLfloat oglLinepos[] =
 //{
 //    SML_SCALE(-10.0),    SML_SCALE(0.0f),   SML_SCALE(0.0f), 1.0f,
@@ -112,135 +69,136 @@ static GLuint oglindics[] = {
 
 
 
-void SmlGLWindowTriangle::GLInitialize()
+void SmlGLWindowTriangle::ResetAxis()
 {
-	/////////////////////////////////////////////////////////////////
-	//ResetEye();
-	_axisEye.Reset();
 	_axisModel.Reset();
 	_axisModel.Translate(glm::vec3(0.0f, 0.0f, SML_SCALE(DISTANCE_POINT)));
 	_axisModel.Scale(glm::vec3(_logicalHeightUnit, _logicalHeightUnit, _logicalHeightUnit));
-	
-
-	/////////////////////////////////////////////////////////////////
-	//initializeOpenGLFunctions();
-
-	//connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &MyOglWidget::on_aboutToBeDestroyed);
-
-	//glDebugMessageCallback(&MyOglWidget::DEBUGPROC, this);
-
-	/////////////////////////////////////////////////////////////////
-    QFile filevert{ ":/shaders/shader/vert.vert" };
-	filevert.open(QFile::ReadOnly);
-	QByteArray vertBuffer = filevert.readAll();
-	filevert.close();
-
-    QFile filefrag{ ":/shaders/shader/frag.frag" };
-	filefrag.open(QFile::ReadOnly);
-	QByteArray fragBuffer = filefrag.readAll();
-	filefrag.close();
-
-	_programId = CreateProgram(vertBuffer.data(), nullptr, fragBuffer.data());
-
-	/////////////////////////////////////////////////////////////////
-	glCreateBuffers(1, &_vboPos);
-	glCreateBuffers(1, &_vboColor);
-	glCreateBuffers(1, &_vboTextCoord);
-	glCreateBuffers(1, &_vboElemet);
-
+}
 
-	glNamedBufferData(_vboPos, sizeof(oglpos), oglpos, GL_STATIC_DRAW);
-	glNamedBufferData(_vboColor, sizeof(oglcolor), oglcolor, GL_STATIC_DRAW);
-	glNamedBufferData(_vboTextCoord, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
-	glNamedBufferData(_vboElemet, sizeof(oglindics), oglindics, GL_STATIC_DRAW);
+void SmlGLWindowTriangle::PublishAxis()
+{
+	_modelSim.SetState(_axisModel);
+}
 
+void SmlGLWindowTriangle::RequestVariants()
+{
+	//all submitted at once, the driver compiles them side by side
+	SmlShaderFiles files;
+	files.vert = ":/shaders/shader/vert.vert";
+	files.frag = ":/shaders/shader/frag.frag";
+	for (int mask = 0; mask < 4; ++mask)
+	{
+		QByteArrayList defines;
+		if (mask & SML_VARIANT_FOG)
+		{
+			defines << "SML_FOG";
+		}
+		if (mask & SML_VARIANT_TEXTURE)
+		{
+			defines << "SML_TEXTURE";
+		}
+		_variants[mask] = RequestProgramVariant(files, defines);
+	}
+}
 
+void SmlGLWindowTriangle::ResolveProgram(const SmlGLProgram& program)
+{
+	//the only name lookups, GLPaint uses the handles
+	_posAttrib = program.Attribute("pos");
+	_colorAttrib = program.Attribute("color");
+	_texCoordAttrib = program.Attribute("textCoord");
+	_frameBlock = program.Block("SmlFrameBlock", sizeof(SmlTriangleFrameBlock));
+	_objectBlock = program.Block("SmlObjectBlock", sizeof(SmlTriangleObjectBlock));
+}
 
-    //QImage imageTemp{QString::fromUtf8(":/image/image/side5.png")};
-    QImage imageTemp{ QString::fromUtf8(":/image/image/tex.jpg") };
-	//QImage image = imageTemp.convertToFormat(QImage::Format_RGB888);
-	QImage image = imageTemp.convertToFormat(QImage::Format_RGBA8888);
-	QImage::Format format = image.format();
-	bool hasalpha = image.hasAlphaChannel();
+GLuint SmlGLWindowTriangle::UploadTexture(QOpenGLFunctions_PROFILE* gl, const QString& fileName)
+{
+	//decode and convert off the render thread, this is the slow part
+	QImage image = QImage{ fileName }.convertToFormat(QImage::Format_RGBA8888);
 	image.mirror();
 
+	GLuint texture = GLuint(-1);
+	gl->glCreateTextures(GL_TEXTURE_2D, 1, &texture);
 
-#if 0
-	glGenTextures(1, &_texture);
-	glBindTexture(GL_TEXTURE_2D, _texture);
+	gl->glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gl->glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	gl->glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	gl->glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_MAG_FILTER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	gl->glTextureStorage2D(
+		texture,//                    GLuint texture,
+		8,//        GLsizei levels,
+		GL_RGBA8,//        GLenum internalformat,
+		image.width(), //        GLsizei width,
+		image.height()//        GLsizei height
+	);
 
-	glTexImage2D(
-		GL_TEXTURE_2D,//                GLenum target,
+	gl->glTextureSubImage2D(
+		texture,//                GLuint texture,
 		0,//    GLint level,
-		GL_RGBA,//    GLint internalFormat,
+		0,//    GLint xoffset,
+		0,//    GLint yoffset,
 		image.width(),//    GLsizei width,
 		image.height(),//    GLsizei height,
-		0,//    GLint border,
 		GL_RGBA,//    GLenum format,
 		GL_UNSIGNED_BYTE,//    GLenum type,
-		image.constBits()//    const GLvoid * data
+		image.constBits()//    const void *pixels
 	);
-	glGenerateMipmap(GL_TEXTURE_2D);
 
+	gl->glGenerateTextureMipmap(texture);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-#else
+	return texture;
+}
 
-	glCreateTextures(GL_TEXTURE_2D, 1, &_texture); //to cleanup
+void SmlGLWindowTriangle::GLInitialize()
+{
+	SML_TRACE_ZONE("SmlGLWindowTriangle::GLInitialize");
 
-	glTextureParameteri(
-		_texture,//                GLuint texture,
-		GL_TEXTURE_MAG_FILTER,//    GLenum pname,
-		GL_LINEAR//    GLfloat param
-	);
+	/////////////////////////////////////////////////////////////////
+	//initializeOpenGLFunctions();
 
-	glTextureParameteri(
-		_texture,//                GLuint texture,
-		GL_TEXTURE_MIN_FILTER,//    GLenum pname,
-        GL_LINEAR_MIPMAP_LINEAR//    GLfloat param
-	);
+	//connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, &MyOglWidget::on_aboutToBeDestroyed);
 
-	glTextureParameteri(
-		_texture,//                GLuint texture,
-		GL_TEXTURE_WRAP_S,//    GLenum pname,
-		GL_REPEAT//    GLfloat param
-	);
+	//glDebugMessageCallback(&MyOglWidget::DEBUGPROC, this);
 
+	/////////////////////////////////////////////////////////////////
+	//the driver compiles while the buffers and textures below are created
+	RequestVariants();
+	EnableUniformRing(SML_UNIFORM_BYTES_PER_FRAME);
 
-	glTextureParameteri(
-		_texture,//                GLuint texture,
-		GL_TEXTURE_WRAP_T,//    GLenum pname,
-		GL_REPEAT//    GLfloat param
-	);
+	/////////////////////////////////////////////////////////////////
+	glCreateBuffers(1, &_vboPos);
+	glCreateBuffers(1, &_vboColor);
+	glCreateBuffers(1, &_vboTextCoord);
+	glCreateBuffers(1, &_vboElemet);
 
-	glTextureStorage2D(
-		_texture,//                    GLuint texture,
-		8,//        GLsizei levels,
-		GL_RGBA8,//        GLenum internalformat,
-		image.width(), //        GLsizei width,
-		image.height()//        GLsizei height
-	);
 
-	glTextureSubImage2D(
-		_texture,//                GLuint texture,
-		0,//    GLint level,
-		0,//    GLint xoffset,
-		0,//    GLint yoffset,
-		image.width(),//    GLsizei width,
-		image.height(),//    GLsizei height,
-		GL_RGBA,//    GLenum format,
-		GL_UNSIGNED_BYTE,//    GLenum type,
-		image.constBits()//    const void *pixels
-	);
+	glNamedBufferData(_vboPos, sizeof(oglpos), oglpos, GL_STATIC_DRAW);
+	glNamedBufferData(_vboColor, sizeof(oglcolor), oglcolor, GL_STATIC_DRAW);
+	glNamedBufferData(_vboTextCoord, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
+	glNamedBufferData(_vboElemet, sizeof(oglindics), oglindics, GL_STATIC_DRAW);
 
-	glGenerateTextureMipmap(_texture);
 
-#endif
+
+	/////////////////////////////////////////////////////////////////
+	//1x1 white until the loader thread has decoded and uploaded the real image
+	const GLubyte white[4] = { 255, 255, 255, 255 };
+	glCreateTextures(GL_TEXTURE_2D, 1, &_texturePlaceholder);
+	glTextureStorage2D(_texturePlaceholder, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(_texturePlaceholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	_texture = _texturePlaceholder;
+
+	auto loaded = std::make_shared<GLuint>(GLuint(-1));
+	UploadAsync(
+		[loaded](QOpenGLFunctions_PROFILE* gl)
+		{
+			*loaded = UploadTexture(gl, QString::fromUtf8(":/image/image/tex.jpg"));
+		},
+		[this, loaded]()
+		{
+			_texture = *loaded; //GLPaint binds it from this frame on
+		});
 
 
 
@@ -255,71 +213,17 @@ void SmlGLWindowTriangle::GLInitialize()
 
 
 	/////////////////////////////////////////////////////////////////
-	glCreateVertexArrays(1, &_vao);
+	//first use, the vao needs the attribute locations; the full variant has every input and
+	//block active, the others share their layout(location) and layout(binding)
+	ResolveProgram(ProgramVariant(_variants[SML_VARIANT_FOG | SML_VARIANT_TEXTURE]));
 
-	glVertexArrayAttribBinding(_vao, posLocation, posLocation);
-	glVertexArrayAttribBinding(_vao, colorLocation, colorLocation);
-	glVertexArrayAttribBinding(_vao, texCoordLocation, texCoordLocation);
-
-	glVertexArrayAttribFormat(
-		_vao,//GLuint vaobj,
-		posLocation,//GLuint attribindex,
-		4,//GLuint size,
-		GL_FLOAT,//GLenum type,
-		false,//GLboolean normalized,
-		0//GLuint relativeoffset
-	);
-
-	glVertexArrayAttribFormat(
-		_vao,//GLuint vaobj,
-		colorLocation,//GLuint attribindex,
-		4,//GLuint size,
-		GL_FLOAT,//GLenum type,
-		false,//GLboolean normalized,
-		0//GLuint relativeoffset
-	);
-
-
-	glVertexArrayAttribFormat(
-		_vao,//GLuint vaobj,
-		texCoordLocation,//GLuint attribindex,
-		2,//GLuint size,
-		GL_FLOAT,//GLenum type,
-		false,//GLboolean normalized,
-		0//GLuint relativeoffset
-	);
-
-	/////////////////////////////////////////////////////////////////
-	glVertexArrayVertexBuffer(
-		_vao,//GLuint vaobj,
-		posLocation,//GLuint bindingindex,
-		_vboPos,//GLuint buffer,
-		0,//GLuintptr offset,
-		sizeof(GLfloat) * 4//,//GLsizei stride
-	);
-
-	glVertexArrayVertexBuffer(
-		_vao,//GLuint vaobj,
-		colorLocation,//GLuint bindingindex,
-		_vboColor,//GLuint buffer,
-		0,//GLuintptr offset,
-		sizeof(GLfloat) * 4//,//GLsizei stride
-	);
-
-	glVertexArrayVertexBuffer(
-		_vao,//GLuint vaobj,
-		texCoordLocation,//GLuint bindingindex,
-		_vboTextCoord,//GLuint buffer,
-		0,//GLuintptr offset,
-		sizeof(GLfloat) * 2//,//GLsizei stride
-	);
+	glCreateVertexArrays(1, &_vao);
 
+	SetVertexAttribute(_vao, _posAttrib, 4, GL_FLOAT, _vboPos, sizeof(GLfloat) * 4);
+	SetVertexAttribute(_vao, _colorAttrib, 4, GL_FLOAT, _vboColor, sizeof(GLfloat) * 4);
+	SetVertexAttribute(_vao, _texCoordAttrib, 2, GL_FLOAT, _vboTextCoord, sizeof(GLfloat) * 2);
 	glVertexArrayElementBuffer(_vao, _vboElemet);
 
-	glEnableVertexArrayAttrib(_vao, posLocation);
-	glEnableVertexArrayAttrib(_vao, colorLocation);
-	glEnableVertexArrayAttrib(_vao, texCoordLocation);
-
 
 
 	/////////////////////////////////////////////////////////////////
@@ -329,16 +233,16 @@ void SmlGLWindowTriangle::GLInitialize()
 }
 
 
-void SmlGLWindowTriangle::on_timeout()
+//simulation thread, fixed dt
+void SmlGLWindowTriangle::TickModel(SmartLib::AxisCoord<float>& axisModel, double dtSeconds)
 {
-
-
-	static constexpr float angle_delta = 1.0f;
-	//static constexpr float angle_delta = 0.0f; //no rotation
-	float radians = glm::radians(angle_delta);
-	_axisModel.Rotate(radians, glm::vec3(1.0f, 0.0f, 0.0f))
+	static constexpr float angle_speed = 60.0f; //degrees per second, was 1 degree per frame
+	//static constexpr float angle_speed = 0.0f; //no rotation
+	float radians = glm::radians(angle_speed * float(dtSeconds));
+	axisModel.Rotate(radians, glm::vec3(1.0f, 0.0f, 0.0f))
 		.Rotate(radians, glm::vec3(0.0f, 1.0f, 0.0f))
 		.Rotate(radians, glm::vec3(0.0f, 0.0f, 1.0f));
+
 	static constexpr float offset_delta = SML_SCALE(0.1f);
 	//    if(_dirInc)
 	//    {
@@ -369,6 +273,8 @@ void SmlGLWindowTriangle::on_timeout()
 
 void SmlGLWindowTriangle::GLResize(const QSize& size, const QSize& oldSize)
 {
+	SML_TRACE_ZONE("SmlGLWindowTriangle::GLResize");
+
     QColor bgcolor = Qt::darkCyan;
     glClearColor(bgcolor.redF(), bgcolor.greenF(), bgcolor.blueF(), 1.0f);
 
@@ -399,53 +305,100 @@ void SmlGLWindowTriangle::GLResize(const QSize& size, const QSize& oldSize)
 
 }
 
+void SmlGLWindowTriangle::SetOverlayText(QString& target, const char* text, int length)
+{
+	//resize keeps the reserved capacity, the characters are written in place
+	length = qBound(0, length, SML_OVERLAY_TEXT_CHARS - 1);
+	target.resize(length);
+	QChar* chars = target.data();
+	for (int ii = 0; ii < length; ++ii)
+	{
+		chars[ii] = QLatin1Char(text[ii]);
+	}
+}
+
 void SmlGLWindowTriangle::GLPaint(QPaintDevice* paintDev)
 {
+	SML_TRACE_ZONE("SmlGLWindowTriangle::GLPaint");
+
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
 	QColor bgcolor = Qt::darkCyan;
 	glClearColor(bgcolor.redF(), bgcolor.greenF(), bgcolor.blueF(), 1.0f);
 
 
-	QPainter painter{ paintDev };
-
-	painter.setPen(Qt::white);
-	painter.setFont(QFont("Arial", 30));
-	painter.drawText(50, 50,  QString::number(++_counter));
-
-	painter.end();
+	{
+		SmlGLProfileScope overlayScope{ Profiler(), "triangle.overlay" };
+
+		//formatted on the stack and copied into strings reserved by the constructor,
+		//only QPainter itself is exempt from the zero allocation check
+		char text[SML_OVERLAY_TEXT_CHARS];
+		int length = snprintf(text, sizeof(text), "%d", ++_counter);
+		SetOverlayText(_counterText, text, length);
+
+		//stutter shows in the tail, not in the average; merging the histograms takes the
+		//stats mutex, a readout refreshed once a second keeps that off the frame path
+		qint64 now = SmlFramePacer::NowNs();
+		if (now - _statsRefreshNs >= SML_STATS_REFRESH_NS)
+		{
+			_statsRefreshNs = now;
+			SmlFrameTimePercentiles present = GetFrameTimes(SmlFrameMetric::PresentInterval, 1);
+			length = snprintf(text, sizeof(text), "present p50 %.1f p99 %.1f max %.1f ms",
+				present.p50Ms, present.p99Ms, present.maxMs);
+			SetOverlayText(_statsText, text, length);
+		}
+
+		{
+			SML_ALLOC_PHASE_EXEMPT("QPainter"); //QPainter allocates its state and text layout on every begin
+			QPainter painter{ paintDev };
+
+			painter.setPen(Qt::white);
+			painter.setFont(_fontCounter);
+			painter.drawText(50, 50, _counterText);
+			painter.setFont(_fontStats);
+			painter.drawText(50, 80, _statsText);
+
+			painter.end();
+		}
+		InvalidateGLState(); //QPainter binds its own program, buffers and textures
+	}
 
 	/////////////////////////////////////////////////////////////////
 
 
-	//    glm::mat4 view = glm::lookAt<float>(
-	//                _eye,
-	//                _eye + glm::vec3(_eyeAxis[2]), //lookinto -z
-	//            glm::vec3(_eyeAxis[1])); //upper y
+	glm::mat4 mvp;
+	{
+		SML_PERF_SCOPE("AxisCoord math");
+
+		//    glm::mat4 view = glm::lookAt<float>(
+		//                _eye,
+		//                _eye + glm::vec3(_eyeAxis[2]), //lookinto -z
+		//            glm::vec3(_eyeAxis[1])); //upper y
 
-	glm::mat4 view = _axisEye.WorldToModelMat();
+		glm::mat4 view = _axisEye.WorldToModelMat();
 
 
-	/////////////////////////////////////////////////////////////////
-	//glm::mat4 modelT{1.0f};
-	//    glm::mat4 modelT = glm::translate(glm::mat4(1.0f),
-	//                                      glm::vec3(SML_SCALE(glm::sin(radians))*2.0f,
-	//                                                SML_SCALE(glm::cos(radians))*2.0f,
-	//                                                SML_SCALE(glm::sin(2*radians))*0.0f));
+		/////////////////////////////////////////////////////////////////
+		//glm::mat4 modelT{1.0f};
+		//    glm::mat4 modelT = glm::translate(glm::mat4(1.0f),
+		//                                      glm::vec3(SML_SCALE(glm::sin(radians))*2.0f,
+		//                                                SML_SCALE(glm::cos(radians))*2.0f,
+		//                                                SML_SCALE(glm::sin(2*radians))*0.0f));
 
-	auto model = _axisModel.ModelToWorldMat();
+		auto model = _modelSim.Sample(SmlFramePacer::NowNs()).ModelToWorldMat();
 
 
-	//glm::mat4 modelS{1.0f};
-	//    glm::mat4 modelS = glm::scale(glm::mat4(1.0f),
-	//            glm::vec3(glm::max(glm::cos(radians), 0.6f) ,
-	//                      glm::max(glm::sin(radians), 0.6f) ,
-	//                      glm::max(glm::cos(2*radians), 0.6f)));
+		//glm::mat4 modelS{1.0f};
+		//    glm::mat4 modelS = glm::scale(glm::mat4(1.0f),
+		//            glm::vec3(glm::max(glm::cos(radians), 0.6f) ,
+		//                      glm::max(glm::sin(radians), 0.6f) ,
+		//                      glm::max(glm::cos(2*radians), 0.6f)));
 
 
-	//glm::mat4  model = modelT * modelR * modelS;
+		//glm::mat4  model = modelT * modelR * modelS;
 
-	glm::mat4 mvp = _frustum * view * model;
+		mvp = _frustum * view * model;
+	}
 
 
 	/////////////////////////////////////////////////////////////////
@@ -478,45 +431,31 @@ void SmlGLWindowTriangle::GLPaint(QPaintDevice* paintDev)
 #endif
 
 	/////////////////////////////////////////////////////////////////
-	glUseProgram(_programId);
-	glBindVertexArray(_vao);
-
-	//static constexpr int mvpLocation = 0;
-	if (-1 == _mvpLocation)
-	{
-		//auto xxxposLocation = glGetAttribLocation(_programId, "pos"); //to xxx
-		//auto xxxcolorLocation = glGetAttribLocation(_programId, "color"); //to xxx
-		_mvpLocation = glGetUniformLocation(_programId, "mvp");
-	}
-	glProgramUniformMatrix4fv(_programId, _mvpLocation, 1, GL_FALSE, glm::value_ptr(mvp));
+	SmlGLProfileScope drawScope{ Profiler(), "triangle.draw" }; //up to the end of GLPaint
 
-    const int texUnit = 2;
-    if (-1 == _texSamplerLocation)
-	{
-        _texSamplerLocation = glGetUniformLocation(_programId, "tex");
-	}
-    glProgramUniform1i(_programId, _texSamplerLocation, texUnit);
+	//written once into the ring region of this frame slot, no per uniform calls
+	SmlTriangleFrameBlock frameBlock;
+	frameBlock.nearFarMaxFog = glm::vec4{ _nearPlane, _farPlane, 6 * _nearPlane, 0.0f };
+	frameBlock.fogColor = glm::vec4{ bgcolor.redF(), bgcolor.greenF(), bgcolor.blueF(), 1.0f };
+	SmlUniformAlloc frameAlloc = UniformRing().Push(frameBlock);
 
-	if (-1 == _nearFarMaxFogLocation)
-	{
-		_nearFarMaxFogLocation = glGetUniformLocation(_programId, "nearFarMaxFog");
-	}
-	glm::vec3 nearFarMaxFog{_nearPlane, _farPlane, 6 * _nearPlane };
-	glProgramUniform3fv(_programId, _nearFarMaxFogLocation, 1, glm::value_ptr(nearFarMaxFog));
-
-	if (-1 == _fogColorLocation)
-	{
-		_fogColorLocation = glGetUniformLocation(_programId, "fogColor");
-	}
-	glm::vec4 fogColor{ bgcolor.redF(), bgcolor.greenF(), bgcolor.blueF(), 1.0f };
-	glProgramUniform4fv(_programId, _fogColorLocation, 1, glm::value_ptr(fogColor));
+	SmlTriangleObjectBlock objectBlock;
+	objectBlock.mvp = mvp;
+	SmlUniformAlloc objectAlloc = UniformRing().Push(objectBlock);
 
+	glUseProgram(ProgramVariant(_variants[_variantMask.load(std::memory_order_relaxed)]).Id());
+	glBindVertexArray(_vao);
 
-    glActiveTexture(GL_TEXTURE0 + texUnit);
-    glBindTextureUnit(texUnit, _texture);
+    glActiveTexture(GL_TEXTURE0 + SML_TEXTURE_UNIT);
+    glBindTextureUnit(SML_TEXTURE_UNIT, _texture);
 
 
-	glDrawElements(GL_TRIANGLES, sizeof(oglindics) / sizeof(oglindics[0]), GL_UNSIGNED_INT, 0);
+	if (frameAlloc.IsValid() && objectAlloc.IsValid()) //ring full, skip rather than draw with stale blocks
+	{
+		BindUniformBlock(_frameBlock, frameAlloc);
+		BindUniformBlock(_objectBlock, objectAlloc);
+		glDrawElements(GL_TRIANGLES, sizeof(oglindics) / sizeof(oglindics[0]), GL_UNSIGNED_INT, 0);
+	}
 
 	/////////////////////////////////////////////////////////////////
 //    glVertexArrayVertexBuffer(
@@ -540,7 +479,7 @@ void SmlGLWindowTriangle::GLPaint(QPaintDevice* paintDev)
 //    glDrawElements(GL_LINES, sizeof(oglLineindics)/sizeof(oglLineindics[0]), GL_UNSIGNED_INT, 0);
 
 	/////////////////////////////////////////////////////////////////
-    glBindTextureUnit(texUnit, 0);
+    glBindTextureUnit(SML_TEXTURE_UNIT, 0);
 	glBindVertexArray(0);
 	glUseProgram(0);
     glActiveTexture(GL_TEXTURE0);
@@ -556,6 +495,8 @@ void SmlGLWindowTriangle::GLPaint(QPaintDevice* paintDev)
 
 void SmlGLWindowTriangle::GLFinalize()
 {
+	SML_TRACE_ZONE("SmlGLWindowTriangle::GLFinalize");
+
 	/////////////////////////////////////////////////////////////////
 	if (_vboPos != -1)
 	{
@@ -581,10 +522,16 @@ void SmlGLWindowTriangle::GLFinalize()
 		_vboTextCoord = -1;
 	}
 
-	if (_texture != -1)
+	if (_texture != -1 && _texture != _texturePlaceholder)
 	{
 		glDeleteTextures(1, &_texture);
-		_texture = -1;
+	}
+	_texture = -1;
+
+	if (_texturePlaceholder != -1)
+	{
+		glDeleteTextures(1, &_texturePlaceholder);
+		_texturePlaceholder = -1;
 	}
 
 
@@ -618,6 +565,8 @@ void SmlGLWindowTriangle::GLFinalize()
 
 void SmlGLWindowTriangle::keyPressEvent(QKeyEvent* ev)
 {
+	SML_TRACE_ZONE("SmlGLWindowTriangle::keyPressEvent");
+
 	//int key = ev->key();
 	//switch (key)
 	//{
@@ -632,15 +581,6 @@ void SmlGLWindowTriangle::keyPressEvent(QKeyEvent* ev)
 	//}
 
 
-	/////////////////////////////////////////////////////////////////
-	static const glm::vec3 AxisX{ 1.0f, 0.0f, 0.0f };
-	static const glm::vec3 AxisY{ 0.0f, 1.0f, 0.0f };
-	static const glm::vec3 AxisZ{ 0.0f, 0.0f, 1.0f };
-
-
-	static constexpr float ratio{ 0.1f };
-	static constexpr float angleDelta{ 2.0f };
-
 	/////////////////////////////////////////////////////////////////
 	switch (ev->key())
 	{
@@ -649,15 +589,140 @@ void SmlGLWindowTriangle::keyPressEvent(QKeyEvent* ev)
 	{
 		_isAnimating = !_isAnimating;
 		SetAnimating(_isAnimating);
-		//ResetEye();
-		_axisEye.Reset();
-		_axisModel.Reset();
-		_axisModel.Translate(glm::vec3(0.0f, 0.0f, SML_SCALE(DISTANCE_POINT)));
-		_axisModel.Scale(glm::vec3(_logicalHeightUnit, _logicalHeightUnit, _logicalHeightUnit));
-		requestUpdate();
+		_modelSim.SetRunning(_isAnimating);
+		ResetAxis();
+		PublishAxis();
+		PostCommand(SmlRenderCommand::Camera(SmlCameraOp::Reset));
+	}
+	break;
+
+	case Qt::Key_R:
+	{
+		PostCommand(SmlRenderCommand::Resource(SML_RESOURCE_RELOAD_PROGRAM));
 	}
 	break;
 
+	case Qt::Key_P:
+	{
+		//toggle the gpu profiler, dump what it measured when it goes off
+		_isProfiling = !_isProfiling;
+		if (!_isProfiling)
+		{
+			for (const SmlGLScopeTiming& timing : GetProfileTimings())
+			{
+				qDebug().noquote() << QString(timing.depth * 2, ' ') + timing.name
+					<< "cpu" << timing.cpuAvgMs << "ms gpu" << timing.gpuAvgMs << "ms";
+			}
+		}
+		SetProfiling(_isProfiling);
+	}
+	break;
+
+	case Qt::Key_G:
+	{
+		//toggle gl call counting, dump the calls of the last frame when it goes off
+		_isCountingGL = !_isCountingGL;
+		if (!_isCountingGL)
+		{
+			SmlGLCallStats stats = GetGLCallStats();
+			qDebug() << stats.frames << "frames," << stats.lastFrameCalls << "calls"
+				<< stats.lastFrameRedundant << "redundant in the last one";
+			for (const SmlGLCallCount& count : stats.lastFrame)
+			{
+				if (count.calls)
+				{
+					qDebug() << " " << count.name << count.calls << "redundant" << count.redundant;
+				}
+			}
+		}
+		SetGLInstrumentation(_isCountingGL);
+	}
+	break;
+
+	case Qt::Key_F:
+	case Qt::Key_T:
+	{
+		//switches the program variant, nothing is compiled here
+		int bit = Qt::Key_F == ev->key() ? SML_VARIANT_FOG : SML_VARIANT_TEXTURE;
+		_variantMask.fetch_xor(bit);
+	}
+	break;
+
+	case Qt::Key_W:
+	case Qt::Key_S:
+	case Qt::Key_A:
+	case Qt::Key_D:
+	case Qt::Key_Q:
+	case Qt::Key_E:
+	case Qt::Key_I:
+	case Qt::Key_K:
+	case Qt::Key_J:
+	case Qt::Key_L:
+	case Qt::Key_U:
+	case Qt::Key_O:
+	{
+		PostCommand(SmlRenderCommand::KeyInput(ev->key(), int(ev->modifiers()))); //applied to _axisEye by the render thread
+	}
+	break;
+
+	default:
+		XQTBase::keyPressEvent(ev);
+	}
+}
+
+void SmlGLWindowTriangle::GLCommand(const SmlRenderCommand& cmd)
+{
+	SML_TRACE_ZONE("SmlGLWindowTriangle::GLCommand");
+
+	switch (cmd.type)
+	{
+	case SmlRenderCommandType::KeyInput:
+		ApplyEyeKey(cmd.keyInput.key);
+		break;
+
+	case SmlRenderCommandType::CameraOp:
+	{
+		glm::vec3 vec{ cmd.camera.x, cmd.camera.y, cmd.camera.z };
+		switch (cmd.camera.op)
+		{
+		case SmlCameraOp::Reset:
+			_axisEye.Reset();
+			break;
+
+		case SmlCameraOp::Translate:
+			_axisEye.Translate(vec);
+			break;
+
+		case SmlCameraOp::Rotate:
+			_axisEye.Rotate(cmd.camera.radians, vec);
+			break;
+		}
+	}
+	break;
+
+	case SmlRenderCommandType::Resource:
+		if (SML_RESOURCE_RELOAD_PROGRAM == cmd.resource.id)
+		{
+			ReloadProgramVariants(); //the old programs draw until the new ones have linked
+		}
+		break;
+	}
+}
+
+void SmlGLWindowTriangle::ApplyEyeKey(int key)
+{
+	/////////////////////////////////////////////////////////////////
+	static const glm::vec3 AxisX{ 1.0f, 0.0f, 0.0f };
+	static const glm::vec3 AxisY{ 0.0f, 1.0f, 0.0f };
+	static const glm::vec3 AxisZ{ 0.0f, 0.0f, 1.0f };
+
+
+	static constexpr float ratio{ 0.1f };
+	static constexpr float angleDelta{ 2.0f };
+
+	/////////////////////////////////////////////////////////////////
+	switch (key)
+	{
 	case Qt::Key_W:
 	{
 		_axisEye.Translate(glm::vec3{ 0.0f, 0.0f, SML_SCALE(-ratio) });
@@ -733,19 +798,40 @@ void SmlGLWindowTriangle::keyPressEvent(QKeyEvent* ev)
 	break;
 
 	default:
-		XQTBase::keyPressEvent(ev);
+		break;
 	}
-	
 }
 
-SmlGLWindowTriangle::SmlGLWindowTriangle(QWindow*parent)
-	: XQTBase(parent)
+SmlGLWindowTriangle::SmlGLWindowTriangle(QWindow*parent, bool requestMode /*= false*/, bool multiThreadMode /*= true*/, bool ctxOwnerMode /*= false*/)
+	: XQTBase(parent, requestMode, multiThreadMode, ctxOwnerMode)
+{
+	ResetAxis();
+	PublishAxis();
+
+	EnableResourceLoader();
+	EnableWaitStats();
+	EnableProgramCache();
+	_counterText.reserve(SML_OVERLAY_TEXT_CHARS);
+	_statsText.reserve(SML_OVERLAY_TEXT_CHARS);
+	_modelSim.start();
+}
+
+SmlGLWindowTriangle::SmlGLWindowTriangle(QWindow*parent, SmlGLRenderService* service)
+	: XQTBase(parent, service)
 {
-	//connect(ThreadGLRender(), &XThreadGLRender::RenderFrameDoneSignal, this, &XGLWindowTriangle::on_timeout);
-	connect(this, &SmlGLWindowTriangle::RenderFrameDoneSignal, this, &SmlGLWindowTriangle::on_timeout);
+	ResetAxis();
+	PublishAxis();
+
+	EnableResourceLoader();
+	EnableWaitStats();
+	EnableProgramCache();
+	_counterText.reserve(SML_OVERLAY_TEXT_CHARS);
+	_statsText.reserve(SML_OVERLAY_TEXT_CHARS);
+	_modelSim.start();
 }
 
 SmlGLWindowTriangle::~SmlGLWindowTriangle()
 {
-	//FinalizeGL();
+	destroy(); //surface event, GLFinalize runs while this part is still alive
+	_modelSim.Stop();
 }
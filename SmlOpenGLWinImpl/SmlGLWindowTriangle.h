@@ -1,10 +1,25 @@
 #pragma once
 
 #include <QObject>
+#include <QFont>
+#include <atomic>
 #include "SmlGLWindow.h"
 
 #include <glm/glm.hpp>
 #include "SmlAxisCoord.h"
+#include "SmlSimulation.h"
+
+//std140 mirrors of the uniform blocks in sml_blocks.glsl, vec3 is padded to vec4
+struct SmlTriangleFrameBlock
+{
+	glm::vec4 nearFarMaxFog; //near, far, max fog distance, unused
+	glm::vec4 fogColor;
+};
+
+struct SmlTriangleObjectBlock
+{
+	glm::mat4 mvp;
+};
 
 class SmlGLWindowTriangle : public SmlGLWindow
 {
@@ -15,13 +30,35 @@ private:
 
 private:
 	bool _isAnimating{ false };
+	bool _isProfiling{ false };
+	bool _isCountingGL{ false };
+	//SML_VARIANT_ bits, ui thread writes, GLPaint picks the program variant
+	std::atomic<int> _variantMask{ SML_VARIANT_FOG | SML_VARIANT_TEXTURE };
 	int _counter{ 0 };
 
+	//built once, a QFont per frame allocates its private data every time
+	QFont _fontCounter{ "Arial", 30 };
+	QFont _fontStats{ "Arial", 12 };
+	//overlay text, render thread, reserved by the constructor so GLPaint rewrites it in place;
+	//the frame time readout is rebuilt every SML_STATS_REFRESH_NS
+	inline static constexpr int SML_OVERLAY_TEXT_CHARS = 96;
+	inline static constexpr qint64 SML_STATS_REFRESH_NS = 1000000000;
+	qint64 _statsRefreshNs{ 0 };
+	QString _counterText;
+	QString _statsText;
+
 
 
 
 private:
-	GLuint _programId{ GLuint(-1) };
+	//one per SML_VARIANT_ combination, all share the layout of vert.vert and frag.frag
+	SmlShaderVariant _variants[4];
+	//resolved at link time, see ResolveProgram
+	SmlGLAttribute _posAttrib;
+	SmlGLAttribute _colorAttrib;
+	SmlGLAttribute _texCoordAttrib;
+	SmlGLUniformBlock _frameBlock;
+	SmlGLUniformBlock _objectBlock;
 	GLuint _vao{ GLuint(-1) };
 
 	GLuint _vboPos{ GLuint(-1) };
@@ -29,7 +66,8 @@ private:
 	GLuint _vboTextCoord{ GLuint(-1) };
 	GLuint _vboElemet{ GLuint(-1) };
 
-	GLuint _texture{ GLuint(-1) };
+	GLuint _texture{ GLuint(-1) };            //what GLPaint binds
+	GLuint _texturePlaceholder{ GLuint(-1) }; //shown until the loader thread is done
 
 	//    GLuint _vboPosLine{GLuint(-1)};
 	//    GLuint _vboColorLine{GLuint(-1)};
@@ -37,12 +75,6 @@ private:
 
 
 
-	GLint _mvpLocation{ -1 };
-    GLint _texSamplerLocation{ -1 };
-
-	GLint _nearFarMaxFogLocation{ -1 };
-	GLint _fogColorLocation{ -1 };
-
 	//QTimer* _updateTimer{nullptr};
 
 
@@ -54,13 +86,25 @@ private:
 
 	bool _axisInited{ false };
 
-	inline static constexpr int posLocation = 0;
-	inline static constexpr int colorLocation = 1;
-	inline static constexpr int texCoordLocation = 2;
+	inline static constexpr GLuint SML_TEXTURE_UNIT = 2; //layout(binding = 2) of tex in frag.frag
+	inline static constexpr GLsizeiptr SML_UNIFORM_BYTES_PER_FRAME = 64 * 1024;
 
+	inline static constexpr int SML_RESOURCE_RELOAD_PROGRAM = 1;
 
+	//compile time features of frag.frag
+	inline static constexpr int SML_VARIANT_FOG = 1;
+	inline static constexpr int SML_VARIANT_TEXTURE = 2;
+
+
+	//ui thread owned, published to the simulation thread as a whole snapshot
 	SmartLib::AxisCoord<float> _axisModel;
+	//render thread owned, changed by the commands drained in GLCommand
 	SmartLib::AxisCoord<float> _axisEye;
+
+	//model animation runs at a fixed rate on its own thread, GLPaint samples it
+	inline static constexpr int SML_SIM_TICK_HZ = 120;
+	SmlSimulation<SmartLib::AxisCoord<float>> _modelSim{ SML_SIM_TICK_HZ, &SmlGLWindowTriangle::TickModel, SmartLib::AxisCoord<float>{} };
+
 	glm::mat4 _frustum;
 
 	float _nearPlane{ 0 };
@@ -74,16 +118,24 @@ private:
 	virtual void GLResize(const QSize& size, const QSize& oldSize) override;
 	virtual void GLPaint(QPaintDevice* paintDev) override;
 	virtual void GLFinalize() override;
+	virtual void GLCommand(const SmlRenderCommand& cmd) override;
 
 private:
-	virtual void keyPressEvent(QKeyEvent* ev) override;
-
-private slots:
-	void on_timeout();
+	void ResetAxis();
+	void PublishAxis();
+	static void TickModel(SmartLib::AxisCoord<float>& axisModel, double dtSeconds);
+	void ApplyEyeKey(int key);
+	void RequestVariants();
+	void ResolveProgram(const SmlGLProgram& program);
+	static void SetOverlayText(QString& target, const char* text, int length);
+	static GLuint UploadTexture(QOpenGLFunctions_PROFILE* gl, const QString& fileName); //loader thread
 
+private:
+	virtual void keyPressEvent(QKeyEvent* ev) override;
 
 
 public:
-	SmlGLWindowTriangle(QWindow *parent);
+	SmlGLWindowTriangle(QWindow *parent, bool requestMode = false, bool multiThreadMode = true, bool ctxOwnerMode = false);
+	SmlGLWindowTriangle(QWindow *parent, SmlGLRenderService* service);
 	virtual ~SmlGLWindowTriangle() override;
 };
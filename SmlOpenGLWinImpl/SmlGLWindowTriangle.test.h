@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QImage>
+#include <QColor>
+
+#include "SmlGLWindowTriangle.h"
+#include "SmlGLRenderService.h"
+
+class SmlGLWindowTest
+{
+private:
+    struct LatencyResult
+    {
+        qint64 avgNs{ 0 };
+        qint64 p99Ns{ 0 };
+        qint64 maxNs{ 0 };
+    };
+
+    static LatencyResult Summarize(std::vector<qint64>& samples)
+    {
+        LatencyResult result;
+        if (samples.empty())
+        {
+            return result;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        qint64 sum = 0;
+        for (qint64 sample : samples)
+        {
+            sum += sample;
+        }
+
+        result.avgNs = sum / qint64(samples.size());
+        result.p99Ns = samples[(samples.size() - 1) * 99 / 100];
+        result.maxNs = samples.back();
+        return result;
+    }
+
+    static void ProcessEventsFor(qint64 ms)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < ms)
+        {
+            QCoreApplication::processEvents();
+        }
+    }
+
+    //ui thread time spent per resize while the render thread keeps animating
+    static LatencyResult ResizeStorm(bool coalesced, int count)
+    {
+        SmlGLWindowTriangle window{ nullptr };
+        window.SetCoalescedResize(coalesced);
+        window.resize(640, 480);
+        window.show();
+        window.SetAnimating(true);
+        ProcessEventsFor(500); //ctx created, first frames rendered
+
+        std::vector<qint64> samples;
+        samples.reserve(count);
+
+        QElapsedTimer timer;
+        for (int ii = 0; ii < count; ++ii)
+        {
+            timer.start();
+            window.resize(640 + ii % 200, 480 + ii % 150);
+            QCoreApplication::processEvents(); //delivers resizeEvent on the ui thread
+            samples.push_back(timer.nsecsElapsed());
+        }
+
+        window.SetAnimating(false);
+        ProcessEventsFor(100);
+        window.destroy(); //GLFinalize while the derived window is still alive
+
+        return Summarize(samples);
+    }
+
+    //renders a few frames without showing the window, the clear color must come back
+    static bool HeadlessFrames(bool requestMode, bool multiThreadMode, bool ctxOwnerMode)
+    {
+        SmlGLWindowTriangle window{ nullptr, requestMode, multiThreadMode, ctxOwnerMode };
+        if (!window.StartHeadless(QSize{ 320, 240 }))
+        {
+            return false;
+        }
+
+        QImage image;
+        for (int ii = 0; ii < 10; ++ii)
+        {
+            window.RenderHeadlessFrame(ii == 9 ? &image : nullptr);
+        }
+        window.FinishHeadless();
+
+        QColor corner = image.isNull() ? QColor{} : image.pixelColor(image.width() - 1, image.height() - 1);
+        return image.size() == QSize{ 320, 240 } && corner == QColor{ Qt::darkCyan };
+    }
+
+    //many animated windows on a couple of service threads, every window must keep presenting
+    static void RenderServiceFrames(int windowCount, int threadCount, int maxFps)
+    {
+        SmlGLRenderService service{ nullptr, threadCount };
+
+        std::vector<SmlGLWindowTriangle*> windows;
+        for (int ii = 0; ii < windowCount; ++ii)
+        {
+            auto* window = new SmlGLWindowTriangle{ nullptr, &service };
+            window->SetFrameBudget(maxFps);
+            window->setPosition(40 + ii % 4 * 330, 40 + ii / 4 * 260);
+            window->resize(320, 240);
+            window->show();
+            window->SetAnimating(true);
+            windows.push_back(window);
+        }
+
+        const int seconds = 2;
+        ProcessEventsFor(seconds * 1000);
+
+        for (int ii = 0; ii < windowCount; ++ii)
+        {
+            SmlFramePacingStats stats = windows[ii]->GetFramePacingStats();
+            qDebug() << "render service window" << ii << "fps:" << stats.framesPresented / seconds
+                << "avg cost ms:" << stats.avgFrameCostMs;
+        }
+
+        for (SmlGLWindowTriangle* window : windows)
+        {
+            window->SetAnimating(false);
+        }
+        ProcessEventsFor(100);
+        for (SmlGLWindowTriangle* window : windows)
+        {
+            delete window; //destroys its surface, GLFinalize on the service thread, before the service
+        }
+    }
+
+    //one animated window per pacing mode, set before show so the swap interval reaches the ctx
+    static SmlFramePacingStats PacedFrames(const SmlFramePacing& pacing, int seconds)
+    {
+        SmlGLWindowTriangle window{ nullptr };
+        window.SetFramePacing(pacing);
+        window.resize(640, 480);
+        window.show();
+        window.SetAnimating(true);
+        ProcessEventsFor(seconds * 1000);
+
+        window.SetAnimating(false);
+        ProcessEventsFor(100);
+        SmlFramePacingStats stats = window.GetFramePacingStats();
+        window.destroy(); //GLFinalize while the derived window is still alive
+        return stats;
+    }
+
+public:
+    static void Case0_ResizeStorm()
+    {
+        const int count = 1000;
+        LatencyResult before = ResizeStorm(false, count);
+        LatencyResult after = ResizeStorm(true, count);
+
+        qDebug() << "resize storm," << count << "resizes, ui thread latency in us";
+        qDebug() << "blocking  avg:" << before.avgNs / 1000 << "p99:" << before.p99Ns / 1000 << "max:" << before.maxNs / 1000;
+        qDebug() << "coalesced avg:" << after.avgNs / 1000 << "p99:" << after.p99Ns / 1000 << "max:" << after.maxNs / 1000;
+    }
+
+    static void Case1_Headless()
+    {
+        qDebug() << "headless single thread:" << HeadlessFrames(false, false, false);
+        qDebug() << "headless ctx move     :" << HeadlessFrames(false, true, false);
+        qDebug() << "headless request mode :" << HeadlessFrames(true, true, false);
+        qDebug() << "headless ctx owner    :" << HeadlessFrames(false, true, true);
+    }
+
+    static void Case2_RenderService()
+    {
+        qDebug() << "render service, 8 windows, 2 threads, unlimited";
+        RenderServiceFrames(8, 2, 0);
+        qDebug() << "render service, 8 windows, 2 threads, 30 fps budget";
+        RenderServiceFrames(8, 2, 30);
+    }
+
+    static void Case3_FramePacing()
+    {
+        struct
+        {
+            const char* name;
+            SmlFramePacing pacing;
+        } modes[] = {
+            { "unpaced      ", SmlFramePacing{ SmlPacingMode::Unpaced } },
+            { "target 30 fps", SmlFramePacing{ SmlPacingMode::TargetFps, 30 } },
+            { "swap interval", SmlFramePacing{ SmlPacingMode::SwapInterval, 60, 1 } },
+            { "deadline 60  ", SmlFramePacing{ SmlPacingMode::Deadline, 60 } },
+        };
+
+        const int seconds = 2;
+        for (const auto& mode : modes)
+        {
+            SmlFramePacingStats stats = PacedFrames(mode.pacing, seconds);
+            qDebug() << mode.name << "fps:" << stats.framesPresented / seconds
+                << "missed:" << stats.framesMissed << "dropped:" << stats.framesDropped
+                << "interval ms:" << stats.avgFrameIntervalMs << "cost ms:" << stats.avgFrameCostMs;
+        }
+    }
+};
@@ -0,0 +1,216 @@
+//compares SmlRenderBench results of a candidate build against a stored baseline and fails
+//when a benchmark got slower beyond its threshold
+//
+//  SmlBenchCompare --baseline base1.json --baseline base2.json --candidate new.json
+//                  --threshold 5 --threshold-for render/large/multi=10
+//
+//runs are matched by key, repeated files of the same side are pooled; a key regresses when
+//the slowdown is statistically significant (Mann-Whitney), the whole bootstrap confidence
+//interval of the median ratio is above 1 and the median ratio is above the threshold; the
+//threshold is raised to twice the run to run spread of the baseline so noisy benchmarks do
+//not flap
+//
+//a baseline benchmark without candidate runs crashed, was renamed or was skipped, it fails
+//the gate unless --allow-missing is given
+//
+//exit code: 0 no regression, 1 regression, 2 usage or input error, 3 missing in candidate
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <QMap>
+
+#include <vector>
+#include <cstdio>
+
+#include "SmlBenchStats.h"
+
+struct SmlBenchSide
+{
+    std::vector<double> samples;    //all runs pooled
+    std::vector<double> runMedians; //one per run, for the noise estimate
+    QString unit;
+};
+
+using SmlBenchSet = QMap<QString, SmlBenchSide>;
+
+static bool SmlLoadRuns(const QString& fileName, SmlBenchSet& set)
+{
+    QFile file{ fileName };
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        fprintf(stderr, "cannot open %s\n", qPrintable(fileName));
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (doc.isNull())
+    {
+        fprintf(stderr, "%s: %s\n", qPrintable(fileName), qPrintable(error.errorString()));
+        return false;
+    }
+
+    for (const QJsonValue& value : doc.object()["runs"].toArray())
+    {
+        QJsonObject run = value.toObject();
+        QString key = run["key"].toString();
+        QJsonArray samples = run["samples"].toArray();
+        if (key.isEmpty() || samples.isEmpty())
+        {
+            continue; //results written before runs had keys
+        }
+
+        SmlBenchSide& side = set[key];
+        std::vector<double> values;
+        values.reserve(samples.size());
+        for (const QJsonValue& sample : samples)
+        {
+            values.push_back(sample.toDouble());
+        }
+        side.runMedians.push_back(SmlBenchStats::Median(values));
+        side.samples.insert(side.samples.end(), values.begin(), values.end());
+        side.unit = run["unit"].toString();
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("SmlBenchCompare");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("benchmark regression gate");
+    parser.addHelpOption();
+    QCommandLineOption baselineOption{ "baseline", "baseline json, repeat for several runs", "file" };
+    QCommandLineOption candidateOption{ "candidate", "candidate json, repeat for several runs", "file" };
+    QCommandLineOption thresholdOption{ "threshold", "allowed slowdown of the median in percent", "percent", "5" };
+    QCommandLineOption thresholdForOption{ "threshold-for", "per benchmark threshold, repeatable", "key=percent" };
+    QCommandLineOption alphaOption{ "alpha", "significance level", "p", "0.01" };
+    QCommandLineOption confidenceOption{ "confidence", "confidence of the median ratio interval", "level", "0.95" };
+    QCommandLineOption allowMissingOption{ "allow-missing", "pass when a baseline benchmark has no candidate runs" };
+    parser.addOptions({ baselineOption, candidateOption, thresholdOption, thresholdForOption, alphaOption, confidenceOption,
+                        allowMissingOption });
+    parser.process(app);
+
+    QStringList baselineFiles = parser.values(baselineOption);
+    QStringList candidateFiles = parser.values(candidateOption);
+    if (baselineFiles.isEmpty() || candidateFiles.isEmpty())
+    {
+        fprintf(stderr, "--baseline and --candidate are required\n");
+        return 2;
+    }
+
+    const double threshold = parser.value(thresholdOption).toDouble() / 100;
+    const double alpha = parser.value(alphaOption).toDouble();
+    const double confidence = parser.value(confidenceOption).toDouble();
+
+    QMap<QString, double> thresholdFor;
+    for (const QString& item : parser.values(thresholdForOption))
+    {
+        int eq = item.lastIndexOf('=');
+        bool ok = false;
+        double percent = eq > 0 ? item.mid(eq + 1).toDouble(&ok) : 0;
+        if (!ok)
+        {
+            fprintf(stderr, "bad --threshold-for %s\n", qPrintable(item));
+            return 2;
+        }
+        thresholdFor[item.left(eq)] = percent / 100;
+    }
+
+    SmlBenchSet baseline;
+    SmlBenchSet candidate;
+    for (const QString& fileName : baselineFiles)
+    {
+        if (!SmlLoadRuns(fileName, baseline))
+        {
+            return 2;
+        }
+    }
+    for (const QString& fileName : candidateFiles)
+    {
+        if (!SmlLoadRuns(fileName, candidate))
+        {
+            return 2;
+        }
+    }
+
+    printf("%-36s %12s %12s %8s %17s %9s %7s  %s\n",
+           "benchmark", "baseline", "candidate", "ratio", "ci", "p", "limit", "verdict");
+
+    int regressions = 0;
+    int missing = 0;
+    for (auto it = baseline.cbegin(); it != baseline.cend(); ++it)
+    {
+        const QString& key = it.key();
+        const SmlBenchSide& base = it.value();
+        auto found = candidate.constFind(key);
+        if (found == candidate.cend())
+        {
+            printf("%-36s %12s %12s %8s %17s %9s %7s  %s\n",
+                   qPrintable(key), "", "-", "", "", "", "", "MISSING in candidate");
+            ++missing;
+            continue;
+        }
+        const SmlBenchSide& cand = found.value();
+
+        double baseMedian = SmlBenchStats::Median(base.samples);
+        double candMedian = SmlBenchStats::Median(cand.samples);
+        double ratio = baseMedian > 0 ? candMedian / baseMedian : 1;
+        SmlBenchStats::Interval ci = SmlBenchStats::BootstrapMedianRatio(base.samples, cand.samples, confidence);
+        double p = SmlBenchStats::MannWhitneyP(base.samples, cand.samples);
+
+        //the limit never goes below what the baseline itself wanders between runs
+        double limit = thresholdFor.value(key, threshold);
+        limit = std::max(limit, 2 * SmlBenchStats::RunToRunSpread(base.runMedians));
+
+        const char* verdict = "same";
+        if (p < alpha && ci.low > 1 && ratio > 1 + limit)
+        {
+            verdict = "REGRESSION";
+            ++regressions;
+        }
+        else if (p < alpha && ci.high < 1 && ratio < 1 - limit)
+        {
+            verdict = "improved";
+        }
+        else if (p < alpha)
+        {
+            verdict = "changed, within limit";
+        }
+
+        QByteArray unit = base.unit.toUtf8();
+        printf("%-36s %9.3f %-2s %9.3f %-2s %8.3f   [%6.3f, %6.3f] %9.2g %6.1f%%  %s\n",
+               qPrintable(key), baseMedian, unit.constData(), candMedian, unit.constData(),
+               ratio, ci.low, ci.high, p, limit * 100, verdict);
+    }
+
+    for (auto it = candidate.cbegin(); it != candidate.cend(); ++it)
+    {
+        if (!baseline.contains(it.key()))
+        {
+            printf("%-36s %12s %12s %8s %17s %9s %7s  %s\n",
+                   qPrintable(it.key()), "-", "", "", "", "", "", "new, no baseline");
+        }
+    }
+
+    if (missing)
+    {
+        printf("\n%d benchmark(s) missing in candidate\n", missing);
+    }
+    if (regressions)
+    {
+        printf("\n%d benchmark(s) regressed\n", regressions);
+        return 1;
+    }
+    if (missing && !parser.isSet(allowMissingOption))
+    {
+        return 3;
+    }
+    return 0;
+}
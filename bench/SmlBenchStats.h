@@ -0,0 +1,164 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+//statistics used to compare two sets of benchmark samples
+//the samples of a benchmark are rarely normal (long tail of slow frames), so everything
+//here is rank or resampling based
+class SmlBenchStats
+{
+public:
+    struct Interval
+    {
+        double low{ 0 };
+        double high{ 0 };
+    };
+
+    static double Median(std::vector<double> values)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+
+        size_t mid = values.size() / 2;
+        std::nth_element(values.begin(), values.begin() + mid, values.end());
+        double upper = values[mid];
+        if (values.size() & 1)
+        {
+            return upper;
+        }
+        double lower = *std::max_element(values.begin(), values.begin() + mid);
+        return (lower + upper) / 2;
+    }
+
+    //two sided Mann-Whitney U test, normal approximation with tie and continuity correction
+    //returns the p value of "a and b come from the same distribution"
+    static double MannWhitneyP(const std::vector<double>& a, const std::vector<double>& b)
+    {
+        const double n1 = double(a.size());
+        const double n2 = double(b.size());
+        if (a.empty() || b.empty())
+        {
+            return 1;
+        }
+
+        struct Sample
+        {
+            double value;
+            bool fromA;
+        };
+        std::vector<Sample> all;
+        all.reserve(a.size() + b.size());
+        for (double value : a)
+        {
+            all.push_back({ value, true });
+        }
+        for (double value : b)
+        {
+            all.push_back({ value, false });
+        }
+        std::sort(all.begin(), all.end(), [](const Sample& l, const Sample& r) { return l.value < r.value; });
+
+        double rankSumA = 0;
+        double tieTerm = 0; //sum of t^3 - t over tie groups
+        for (size_t ii = 0; ii < all.size();)
+        {
+            size_t jj = ii;
+            while (jj < all.size() && all[jj].value == all[ii].value)
+            {
+                ++jj;
+            }
+
+            double ties = double(jj - ii);
+            double rank = (double(ii + 1) + double(jj)) / 2; //average rank of the group, 1 based
+            for (size_t kk = ii; kk < jj; ++kk)
+            {
+                if (all[kk].fromA)
+                {
+                    rankSumA += rank;
+                }
+            }
+            tieTerm += ties * ties * ties - ties;
+            ii = jj;
+        }
+
+        const double n = n1 + n2;
+        const double u = rankSumA - n1 * (n1 + 1) / 2;
+        const double mean = n1 * n2 / 2;
+        const double variance = n1 * n2 / 12 * ((n + 1) - tieTerm / (n * (n - 1)));
+        if (variance <= 0)
+        {
+            return 1; //every sample identical
+        }
+
+        double diff = std::abs(u - mean) - 0.5;
+        double z = std::max(diff, 0.0) / std::sqrt(variance);
+        return std::erfc(z / std::sqrt(2.0));
+    }
+
+    //percentile bootstrap confidence interval of median(candidate) / median(baseline)
+    //the seed is fixed so that the same inputs always produce the same verdict
+    static Interval BootstrapMedianRatio(const std::vector<double>& baseline, const std::vector<double>& candidate,
+                                         double confidence = 0.95, int resamples = 2000, unsigned seed = 20240601u)
+    {
+        Interval interval;
+        if (baseline.empty() || candidate.empty())
+        {
+            return interval;
+        }
+
+        std::mt19937 rng{ seed };
+        std::vector<double> ratios;
+        ratios.reserve(resamples);
+        std::vector<double> base(baseline.size());
+        std::vector<double> cand(candidate.size());
+        std::uniform_int_distribution<size_t> pickBase{ 0, baseline.size() - 1 };
+        std::uniform_int_distribution<size_t> pickCand{ 0, candidate.size() - 1 };
+        for (int rr = 0; rr < resamples; ++rr)
+        {
+            for (double& value : base)
+            {
+                value = baseline[pickBase(rng)];
+            }
+            for (double& value : cand)
+            {
+                value = candidate[pickCand(rng)];
+            }
+
+            double baseMedian = Median(base);
+            if (baseMedian > 0)
+            {
+                ratios.push_back(Median(cand) / baseMedian);
+            }
+        }
+
+        if (ratios.empty())
+        {
+            return interval;
+        }
+
+        std::sort(ratios.begin(), ratios.end());
+        double tail = (1 - confidence) / 2;
+        interval.low = ratios[size_t(tail * (ratios.size() - 1))];
+        interval.high = ratios[size_t((1 - tail) * (ratios.size() - 1))];
+        return interval;
+    }
+
+    //relative spread of the per run medians, how much the baseline moves between repeated
+    //runs of the same build; 0 when there is only one run
+    static double RunToRunSpread(const std::vector<double>& runMedians)
+    {
+        if (runMedians.size() < 2)
+        {
+            return 0;
+        }
+
+        auto [lo, hi] = std::minmax_element(runMedians.begin(), runMedians.end());
+        double median = Median(runMedians);
+        return median > 0 ? (*hi - *lo) / median : 0;
+    }
+};
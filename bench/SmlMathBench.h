@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QElapsedTimer>
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "SmlAxisCoord.h"
+#include "SmlGlmUtils.h"
+
+//micro benchmarks of the Sml3DMath kernels the render path calls every frame
+//every sample is the average ns per call over one batch
+class SmlMathBench
+{
+private:
+    using Kernel = std::function<float(int ii)>; //returns something derived from the result so it is not optimized away
+
+    struct Case
+    {
+        const char* name;
+        Kernel kernel;
+    };
+
+    static QJsonObject Run(const Case& test, int samples, int batch)
+    {
+        volatile float sink = 0;
+        for (int ii = 0; ii < batch; ++ii)
+        {
+            sink = sink + test.kernel(ii); //warm up
+        }
+
+        QJsonArray values;
+        QElapsedTimer timer;
+        for (int ss = 0; ss < samples; ++ss)
+        {
+            timer.start();
+            float acc = 0;
+            for (int ii = 0; ii < batch; ++ii)
+            {
+                acc += test.kernel(ii);
+            }
+            sink = sink + acc;
+            values.append(double(timer.nsecsElapsed()) / batch);
+        }
+
+        QJsonObject result;
+        result["key"] = QString{ "math/" } + test.name;
+        result["suite"] = "math";
+        result["kernel"] = test.name;
+        result["unit"] = "ns";
+        result["batch"] = batch;
+        result["samples"] = values;
+        return result;
+    }
+
+public:
+    static QJsonArray RunAll(int samples, int batch)
+    {
+        using AxisCoordF = SmartLib::AxisCoord<float>;
+
+        AxisCoordF model;
+        model.Translate(glm::vec3{ 0.0f, 0.0f, -40.0f });
+        model.Scale(glm::vec3{ 8.0f });
+
+        AxisCoordF from = model;
+        AxisCoordF to = model;
+        to.Rotate(1.0f, glm::vec3{ 0.0f, 1.0f, 0.0f });
+        to.Translate(glm::vec3{ 1.0f, 2.0f, 3.0f });
+
+        const glm::mat4 frustum = SmartLib::GlmUtils<float>::Frustum(-8.0f, 8.0f, -8.0f, 8.0f, 16.0f, 4096.0f);
+
+        const Case cases[] =
+        {
+            { "AxisCoord.Rotate", [&model](int ii)
+                {
+                    model.Rotate(0.001f * (ii & 7), glm::vec3{ 0.0f, 1.0f, 0.0f });
+                    return model.GetAxis()[0][0];
+                } },
+            { "AxisCoord.Translate", [&model](int ii)
+                {
+                    model.Translate(glm::vec3{ 0.001f * (ii & 3), 0.0f, 0.0f });
+                    return model.GetOrigin().x;
+                } },
+            { "AxisCoord.ModelToWorldMat", [&model](int)
+                {
+                    return model.ModelToWorldMat()[3][2];
+                } },
+            { "AxisCoord.WorldToModelMat", [&model](int)
+                {
+                    return model.WorldToModelMat()[3][2];
+                } },
+            { "AxisCoord.Interpolate", [&from, &to](int ii)
+                {
+                    return AxisCoordF::Interpolate(from, to, float(ii & 255) / 255.0f).GetOrigin().z;
+                } },
+            { "GlmUtils.Frustum", [](int ii)
+                {
+                    float half = 8.0f + float(ii & 15);
+                    return SmartLib::GlmUtils<float>::Frustum(-half, half, -8.0f, 8.0f, 16.0f, 4096.0f)[0][0];
+                } },
+            { "Mvp", [&model, &frustum](int)
+                {
+                    return (frustum * model.WorldToModelMat() * model.ModelToWorldMat())[3][3];
+                } },
+        };
+
+        QJsonArray runs;
+        for (const Case& test : cases)
+        {
+            runs.append(Run(test, samples, batch));
+        }
+        return runs;
+    }
+};
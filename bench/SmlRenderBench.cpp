@@ -0,0 +1,335 @@
+//headless render benchmark: draws SmlGLWindowCubes scenes for a fixed number of frames
+//per preset and threading mode and writes the results as json, the math suite times
+//the Sml3DMath kernels; every run has a key and raw samples for SmlBenchCompare
+//
+//  SmlRenderBench --preset small,large --mode single,multi --frames 500 --output result.json
+//  SmlRenderBench --suite math --output math.json
+//
+//no window is ever shown, but the platform plugin must still hand out a gl ctx: the offscreen
+//plugin (picked when no display is set) only does so through GLX, so on a box without X run
+//under xvfb-run or set QT_QPA_PLATFORM to an EGL plugin such as eglfs; without a ctx the
+//render suite stops with exit code 3
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDateTime>
+#include <QSysInfo>
+
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+#include "SmlSurfaceFormat.h"
+#include "SmlGLWindowCubes.h"
+#include "SmlMathBench.h"
+
+
+struct SmlBenchPreset
+{
+    const char* name;
+    SmlCubeScene scene;
+};
+
+static const SmlBenchPreset SML_BENCH_PRESETS[] =
+{
+    { "tiny",   { 1,       256 } },
+    { "small",  { 1000,    512 } },
+    { "medium", { 100000,  1024 } },
+    { "large",  { 1000000, 2048 } },
+};
+
+struct SmlBenchMode
+{
+    const char* name;
+    bool requestMode;
+    bool multiThreadMode;
+    bool ctxOwnerMode;
+};
+
+static const SmlBenchMode SML_BENCH_MODES[] =
+{
+    { "single",  false, false, false },
+    { "multi",   false, true,  false },
+    { "request", true,  true,  false },
+    { "owner",   false, true,  true  },
+};
+
+struct SmlBenchConfig
+{
+    int frames{ 300 };
+    int warmup{ 30 };
+    QSize size{ 1280, 720 };
+};
+
+
+static QJsonObject SmlPercentilesJson(std::vector<double> samplesMs)
+{
+    QJsonObject json;
+    if (samplesMs.empty())
+    {
+        return json;
+    }
+
+    std::sort(samplesMs.begin(), samplesMs.end());
+    auto at = [&samplesMs](double ratio) { return samplesMs[size_t(ratio * (samplesMs.size() - 1))]; };
+
+    double sum = 0;
+    for (double sample : samplesMs)
+    {
+        sum += sample;
+    }
+
+    json["mean"] = sum / samplesMs.size();
+    json["p50"] = at(0.50);
+    json["p95"] = at(0.95);
+    json["p99"] = at(0.99);
+    json["max"] = samplesMs.back();
+    return json;
+}
+
+static QJsonObject SmlWindowTimesJson(const SmlFrameTimePercentiles& times)
+{
+    QJsonObject json;
+    json["count"] = qint64(times.count);
+    json["p50"] = times.p50Ms;
+    json["p95"] = times.p95Ms;
+    json["p99"] = times.p99Ms;
+    json["max"] = times.maxMs;
+    return json;
+}
+
+static QJsonObject SmlRunBench(const SmlBenchPreset& preset, const SmlBenchMode& mode, const SmlBenchConfig& config)
+{
+    SmlGLWindowCubes window{ nullptr, preset.scene, mode.requestMode, mode.multiThreadMode, mode.ctxOwnerMode };
+    if (!window.StartHeadless(config.size))
+    {
+        return QJsonObject{}; //the reason is logged by StartHeadless
+    }
+
+    for (int ii = 0; ii < config.warmup; ++ii)
+    {
+        window.RenderHeadlessFrame();
+    }
+
+    //wall time per frame as the ui thread sees it, the gpu is drained by the frames in flight limit
+    std::vector<double> samplesMs;
+    samplesMs.reserve(config.frames);
+
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer frame;
+    for (int ii = 0; ii < config.frames; ++ii)
+    {
+        frame.start();
+        window.RenderHeadlessFrame();
+        samplesMs.push_back(frame.nsecsElapsed() / 1e6);
+    }
+    double seconds = total.nsecsElapsed() / 1e9;
+
+    QJsonObject result;
+    result["key"] = QString{ "render/%1/%2" }.arg(preset.name, mode.name);
+    result["suite"] = "render";
+    result["preset"] = preset.name;
+    result["mode"] = mode.name;
+    result["cubes"] = preset.scene.cubeCount;
+    result["textureSize"] = preset.scene.textureSize;
+    result["width"] = config.size.width();
+    result["height"] = config.size.height();
+    result["frames"] = config.frames;
+    result["seconds"] = seconds;
+    result["fps"] = config.frames / seconds;
+    result["cubesPerSecond"] = double(preset.scene.cubeCount) * config.frames / seconds;
+    result["frameMs"] = SmlPercentilesJson(samplesMs);
+    result["cpuFrameMs"] = SmlWindowTimesJson(window.GetFrameTimes(SmlFrameMetric::CpuFrame, SmlFrameStats::SML_WINDOW_SLOTS));
+    result["gpuFrameMs"] = SmlWindowTimesJson(window.GetFrameTimes(SmlFrameMetric::GpuFrame, SmlFrameStats::SML_WINDOW_SLOTS));
+
+    //startup, cold with SML_PROGRAM_CACHE=0 or an empty cache dir, warm otherwise
+    SmlGLProgramCacheStats programCache = window.GetProgramCacheStats();
+    QJsonObject programCacheJson;
+    programCacheJson["hits"] = qint64(programCache.hits);
+    programCacheJson["misses"] = qint64(programCache.misses);
+    programCacheJson["rejected"] = qint64(programCache.rejected);
+    programCacheJson["hitMs"] = programCache.hitMs;
+    programCacheJson["missMs"] = programCache.missMs;
+    result["programCache"] = programCacheJson;
+
+    QJsonArray samples; //raw, for the comparison tool
+    for (double sample : samplesMs)
+    {
+        samples.append(sample);
+    }
+    result["unit"] = "ms";
+    result["samples"] = samples;
+
+    window.FinishHeadless();
+    return result;
+}
+
+static QJsonObject SmlEnvironmentJson()
+{
+    QJsonObject json;
+    json["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    json["host"] = QSysInfo::machineHostName();
+    json["os"] = QSysInfo::prettyProductName();
+    json["cpu"] = QSysInfo::currentCpuArchitecture();
+    json["platform"] = QGuiApplication::platformName();
+
+    QOffscreenSurface surface;
+    surface.setFormat(QSurfaceFormat::defaultFormat());
+    surface.create();
+    QOpenGLContext ctx;
+    ctx.setFormat(QSurfaceFormat::defaultFormat());
+    if (ctx.create() && ctx.makeCurrent(&surface))
+    {
+        QOpenGLFunctions* gl = ctx.functions();
+        json["glVendor"] = reinterpret_cast<const char*>(gl->glGetString(GL_VENDOR));
+        json["glRenderer"] = reinterpret_cast<const char*>(gl->glGetString(GL_RENDERER));
+        json["glVersion"] = reinterpret_cast<const char*>(gl->glGetString(GL_VERSION));
+        ctx.doneCurrent();
+    }
+    return json;
+}
+
+template<typename T, size_t N>
+static const T* SmlFindByName(const T (&items)[N], const QString& name)
+{
+    for (const T& item : items)
+    {
+        if (name == QLatin1String(item.name))
+        {
+            return &item;
+        }
+    }
+    return nullptr;
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") &&
+        qEnvironmentVariableIsEmpty("DISPLAY") && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    SmlSurfaceFormatUtils::SurfaceFormat();
+    QGuiApplication app(argc, argv);
+    QGuiApplication::setApplicationName("SmlRenderBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("headless SmlGLWindow render benchmark");
+    parser.addHelpOption();
+    QCommandLineOption suiteOption{ "suite", "comma separated: render, math", "names", "render" };
+    QCommandLineOption presetOption{ "preset", "comma separated: tiny, small, medium, large", "names", "tiny,small,medium" };
+    QCommandLineOption modeOption{ "mode", "comma separated: single, multi, request, owner", "names", "single,multi,request" };
+    QCommandLineOption cubesOption{ "cubes", "overrides the cube count of every preset", "count" };
+    QCommandLineOption textureOption{ "texture", "overrides the texture size of every preset", "pixels" };
+    QCommandLineOption framesOption{ "frames", "measured frames per run", "count", "300" };
+    QCommandLineOption warmupOption{ "warmup", "frames rendered before measuring", "count", "30" };
+    QCommandLineOption sizeOption{ "size", "framebuffer size", "WxH", "1280x720" };
+    QCommandLineOption outputOption{ "output", "json file, stdout when not given", "file" };
+    parser.addOptions({ suiteOption, presetOption, modeOption, cubesOption, textureOption, framesOption, warmupOption, sizeOption, outputOption });
+    parser.process(app);
+
+    SmlBenchConfig config;
+    config.frames = std::max(parser.value(framesOption).toInt(), 1);
+    config.warmup = std::max(parser.value(warmupOption).toInt(), 0);
+    QStringList size = parser.value(sizeOption).split('x');
+    if (2 == size.size())
+    {
+        config.size = QSize{ std::max(size[0].toInt(), 1), std::max(size[1].toInt(), 1) };
+    }
+
+    std::vector<SmlBenchPreset> presets;
+    for (const QString& name : parser.value(presetOption).split(',', Qt::SkipEmptyParts))
+    {
+        const SmlBenchPreset* preset = SmlFindByName(SML_BENCH_PRESETS, name.trimmed());
+        if (nullptr == preset)
+        {
+            fprintf(stderr, "unknown preset %s\n", qPrintable(name));
+            return 2;
+        }
+
+        SmlBenchPreset selected = *preset;
+        if (parser.isSet(cubesOption))
+        {
+            selected.scene.cubeCount = std::clamp(parser.value(cubesOption).toInt(), 1, 1000000);
+        }
+        if (parser.isSet(textureOption))
+        {
+            selected.scene.textureSize = std::clamp(parser.value(textureOption).toInt(), 1, 16384);
+        }
+        presets.push_back(selected);
+    }
+
+    std::vector<SmlBenchMode> modes;
+    for (const QString& name : parser.value(modeOption).split(',', Qt::SkipEmptyParts))
+    {
+        const SmlBenchMode* mode = SmlFindByName(SML_BENCH_MODES, name.trimmed());
+        if (nullptr == mode)
+        {
+            fprintf(stderr, "unknown mode %s\n", qPrintable(name));
+            return 2;
+        }
+        modes.push_back(*mode);
+    }
+
+    QStringList suites = parser.value(suiteOption).split(',', Qt::SkipEmptyParts);
+
+    QJsonArray runs;
+    if (suites.contains("render"))
+    {
+        for (const SmlBenchPreset& preset : presets)
+        {
+            for (const SmlBenchMode& mode : modes)
+            {
+                fprintf(stderr, "render/%s/%s ...\n", preset.name, mode.name);
+                QJsonObject run = SmlRunBench(preset, mode, config);
+                if (run.isEmpty())
+                {
+                    fprintf(stderr, "no OpenGL context on the %s platform, see the warning above\n",
+                        qPrintable(QGuiApplication::platformName()));
+                    return 3;
+                }
+                runs.append(run);
+            }
+        }
+    }
+
+    if (suites.contains("math"))
+    {
+        fprintf(stderr, "math ...\n");
+        for (const QJsonValue& run : SmlMathBench::RunAll(200, 10000))
+        {
+            runs.append(run);
+        }
+    }
+
+    QJsonObject root;
+    root["benchmark"] = "SmlRenderBench";
+    root["environment"] = SmlEnvironmentJson();
+    root["runs"] = runs;
+    QByteArray json = QJsonDocument{ root }.toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption))
+    {
+        QFile file{ parser.value(outputOption) };
+        if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(json) != json.size())
+        {
+            fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    }
+    else
+    {
+        fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return 0;
+}
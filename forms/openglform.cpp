@@ -2,14 +2,21 @@
 #include "ui_openglform.h"
 #include "SmlGLWindowTriangle.h"
 
-openGLForm::openGLForm(QWidget *parent) :
+openGLForm::openGLForm(QWidget *parent, SmlGLRenderService* service) :
     QWidget(parent),
     ui(new Ui::openGLForm)
 {
     ui->setupUi(this);
 
     ///////////////////////////////////////////////////
-    _glwin = new SmlGLWindowTriangle(nullptr);
+    if (service)
+    {
+        _glwin = new SmlGLWindowTriangle(nullptr, service);
+    }
+    else
+    {
+        _glwin = new SmlGLWindowTriangle(nullptr);
+    }
     _glwin->setFlags(Qt::FramelessWindowHint);
     _glwin->create();
     _cont = QWidget::createWindowContainer(_glwin, this, Qt::FramelessWindowHint);
@@ -4,6 +4,8 @@
 #include <QWidget>
 #include <QWindow>
 
+class SmlGLRenderService;
+
 namespace Ui {
 class openGLForm;
 }
@@ -13,7 +15,8 @@ class openGLForm : public QWidget
     Q_OBJECT
 
 public:
-    explicit openGLForm(QWidget *parent = nullptr);
+    //with a service all forms share its render threads instead of one thread per form
+    explicit openGLForm(QWidget *parent = nullptr, SmlGLRenderService* service = nullptr);
     ~openGLForm();
 
 private:
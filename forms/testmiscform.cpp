@@ -1,6 +1,9 @@
 #include "testmiscform.h"
 #include "ui_testmiscform.h"
 #include "SmlAxisCoord.test.h"
+#include "SmlGLWindowTriangle.test.h"
+#include "SmlShaderPreprocessor.test.h"
+#include "SmlWaitObject.test.h"
 
 TestMiscForm::TestMiscForm(QWidget *parent) :
     QWidget(parent),
@@ -37,3 +40,50 @@ void TestMiscForm::on_pushButtonTestTBN_clicked()
     ui->pushButtonTestTBN->setEnabled(true);
 }
 
+
+void TestMiscForm::on_pushButtonTestResizeStorm_clicked()
+{
+    ui->pushButtonTestResizeStorm->setEnabled(false);
+    SmlGLWindowTest::Case0_ResizeStorm();
+    ui->pushButtonTestResizeStorm->setEnabled(true);
+}
+
+
+void TestMiscForm::on_pushButtonTestWaitObjects_clicked()
+{
+    ui->pushButtonTestWaitObjects->setEnabled(false);
+    SmlWaitObjectTest::Case0_WaitObjectBench();
+    ui->pushButtonTestWaitObjects->setEnabled(true);
+}
+
+
+void TestMiscForm::on_pushButtonTestHeadless_clicked()
+{
+    ui->pushButtonTestHeadless->setEnabled(false);
+    SmlGLWindowTest::Case1_Headless();
+    ui->pushButtonTestHeadless->setEnabled(true);
+}
+
+
+void TestMiscForm::on_pushButtonTestRenderService_clicked()
+{
+    ui->pushButtonTestRenderService->setEnabled(false);
+    SmlGLWindowTest::Case2_RenderService();
+    ui->pushButtonTestRenderService->setEnabled(true);
+}
+
+
+void TestMiscForm::on_pushButtonTestFramePacing_clicked()
+{
+    ui->pushButtonTestFramePacing->setEnabled(false);
+    SmlGLWindowTest::Case3_FramePacing();
+    ui->pushButtonTestFramePacing->setEnabled(true);
+}
+
+
+void TestMiscForm::on_pushButtonTestShaderPreprocessor_clicked()
+{
+    ui->pushButtonTestShaderPreprocessor->setEnabled(false);
+    SmlShaderPreprocessorTest::Case0_IncludesAndDefines();
+    ui->pushButtonTestShaderPreprocessor->setEnabled(true);
+}
@@ -22,6 +22,18 @@ private slots:
 
     void on_pushButtonTestTBN_clicked();
 
+    void on_pushButtonTestResizeStorm_clicked();
+
+    void on_pushButtonTestWaitObjects_clicked();
+
+    void on_pushButtonTestHeadless_clicked();
+
+    void on_pushButtonTestRenderService_clicked();
+
+    void on_pushButtonTestFramePacing_clicked();
+
+    void on_pushButtonTestShaderPreprocessor_clicked();
+
 private:
     Ui::TestMiscForm *ui;
 };
@@ -1,12 +1,24 @@
 #include "smlthreadedopenglmainwindow.h"
 #include "SmlSurfaceFormat.h"
+#include "SmlTrace.h"
+#include "SmlWaitObject.h"
+#include "SmlAllocTracker.h"
+#include "SmlPerfCounters.h"
 #include <QApplication>
+#include <QThread>
 
 int main(int argc, char *argv[])
 {
     SmlSurfaceFormatUtils::SurfaceFormat();
+    QThread::currentThread()->setObjectName("ui");
     QApplication a(argc, argv);
     SmlThreadedOpenglMainWindow w;
     w.show();
-    return a.exec();
+    int ret = a.exec();
+
+    SML_TRACE_EXPORT("SmlThreadedGLApp.trace.json"); //open in chrome://tracing or ui.perfetto.dev
+    SmlWaitStats::DumpAll();
+    SML_ALLOC_DUMP();
+    SML_PERF_DUMP();
+    return ret;
 }
@@ -2,13 +2,13 @@
 
 in vec4 vertColor;
 in vec2 textCoordV;
-out vec4 finalColor;
 
 uniform sampler2D tex;
 
+out vec4 finalColor;
+
 void main(void)
 {
-    //gl_FragColor = vertColor;
-    finalColor = vertColor;
-    //finalColor = texture(tex, textCoordV);
+    const float ratio = 0.2;
+    finalColor = mix(texture(tex, textCoordV), vertColor, ratio);
 }
@@ -3,15 +3,17 @@
 layout(location=0) in vec4 pos;
 layout(location=1) in vec4 color;
 layout(location=2) in vec2 textCoord;
+layout(location=3) in vec4 instanceOffset; //xyz translation, w scale
 
-uniform mat4 mvp;
+uniform mat4 viewProj;
 
 out vec4 vertColor;
 out vec2 textCoordV;
 
 void main(void)
 {
-    gl_Position = mvp * pos;
+    vec4 world = vec4(pos.xyz * instanceOffset.w + instanceOffset.xyz, 1.0);
+    gl_Position = viewProj * world;
     vertColor = color;
     textCoordV = textCoord;
 }
@@ -1,31 +1,28 @@
 #version 450 core
 
+//variants: SML_TEXTURE mixes the texture into the vertex color, SML_FOG fades to fogColor
+#include "sml_blocks.glsl"
+#include "sml_fog.glsl"
+
 in vec4 vertColor;
 in vec2 textCoordV;
 
-uniform sampler2D tex;
-uniform vec3 nearFarMaxFog;
-uniform vec4 fogColor;
+layout(binding = 2) uniform sampler2D tex;
 
 out vec4 finalColor;
 
 void main(void)
 {
-    //gl_FragColor = vertColor;
-    //finalColor = vertColor;
-    float near = nearFarMaxFog.x;
-    float far = nearFarMaxFog.y;
-    float MaxFrog = nearFarMaxFog.z;
-    float realz = (near * far) / (far + (near - far) * gl_FragCoord.z);
-
-    float fogRatio = 1.0;
-    if(realz < MaxFrog)
-    {
-        fogRatio = (realz - near)/(MaxFrog - near);
-    }
-
+#ifdef SML_TEXTURE
     const float ratio = 0.2;
-    vec4 objColor =mix(texture(tex, textCoordV), vertColor, ratio);
-    
-    finalColor = mix(objColor, fogColor, fogRatio);
-}
\ No newline at end of file
+    vec4 objColor = mix(texture(tex, textCoordV), vertColor, ratio);
+#else
+    vec4 objColor = vertColor;
+#endif
+
+#ifdef SML_FOG
+    finalColor = SmlApplyFog(objColor);
+#else
+    finalColor = objColor;
+#endif
+}
@@ -0,0 +1,14 @@
+//uniform blocks written by the SmlUniformRing, mirrored by SmlTriangleFrameBlock
+//and SmlTriangleObjectBlock in SmlGLWindowTriangle.h
+
+//x near, y far, z max fog distance
+layout(std140, binding = 0) uniform SmlFrameBlock
+{
+    vec4 nearFarMaxFog;
+    vec4 fogColor;
+};
+
+layout(std140, binding = 1) uniform SmlObjectBlock
+{
+    mat4 mvp;
+};
@@ -0,0 +1,11 @@
+//linear fog from the near plane up to the max fog distance, full fog beyond it
+vec4 SmlApplyFog(vec4 color)
+{
+    float near = nearFarMaxFog.x;
+    float far = nearFarMaxFog.y;
+    float maxFog = nearFarMaxFog.z;
+    float realz = (near * far) / (far + (near - far) * gl_FragCoord.z);
+
+    float fogRatio = min((realz - near) / (maxFog - near), 1.0);
+    return mix(color, fogColor, fogRatio);
+}